@@ -1,9 +1,16 @@
 // bst_visualizer_final.cpp
 // BST Visualizer - Insert/Delete/Search with validations and animations.
 // Messages now show the user-entered value (not node value).
-// Compile with: g++ bst_visualizer_final.cpp -o bst_vis -std=c++17 `pkg-config --cflags --libs raylib`
+// Compile with: g++ bst_visualizer_final.cpp -o bst_vis -std=c++17 -pthread `pkg-config --cflags --libs raylib`
+// Headless benchmark build (no raylib): g++ -O2 -std=c++17 -pthread -DBST_HEADLESS bst_visualizer_final.cpp -o bst_bench
 
+#ifndef BST_HEADLESS
+#define BST_HEADLESS 0
+#endif
+
+#if !BST_HEADLESS
 #include "raylib.h"
+#endif
 #include <iostream>
 #include <string>
 #include <vector>
@@ -12,89 +19,471 @@
 #include <algorithm>
 #include <functional>
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <limits>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#if defined(_WIN32)
+// Declared by hand: <windows.h> clashes with raylib (Rectangle, DrawText, CloseWindow...).
+extern "C" __declspec(dllimport) void* __stdcall VirtualAlloc(void* address, size_t size, unsigned long type, unsigned long protect);
+extern "C" __declspec(dllimport) int __stdcall VirtualFree(void* address, size_t size, unsigned long type);
+#else
+#include <sys/mman.h>
+#endif
+
+// ---------- Build options ----------
+// BST_HEADLESS: no window, no raylib. Nodes drop every layout/animation field and
+// shrink to 16 bytes (key + two 32-bit child links), four per cache line. All tree
+// algorithms below are shared with the visual build; main() becomes a benchmark driver.
+//
+// BST_PARENT_LINKS: every node keeps a link to its parent. Relinking a node
+// (ReplaceChild) and in-order stepping (InorderNext/InorderPrev) then no longer
+// need a descent from the root. Costs one 32-bit link per node; on by default in
+// the visual build, off by default in the headless one.
+#ifndef BST_PARENT_LINKS
+#define BST_PARENT_LINKS (!BST_HEADLESS)
+#endif
+
+// BST_MERKLE: every node keeps a hash of its key, tombstone flag and both
+// children's hashes, refreshed bottom-up along the modified path after each
+// operation. Equal trees then compare in O(1) by root hash, storing an unchanged
+// tree as a named tree is skipped and the structural diff reads the stored
+// hashes. Costs 8 bytes per node and O(height) per update; needs
+// BST_PARENT_LINKS. Off by default.
+#ifndef BST_MERKLE
+#define BST_MERKLE 0
+#endif
+#if BST_MERKLE && !BST_PARENT_LINKS
+#error "BST_MERKLE walks parent links up the modified path; build with BST_PARENT_LINKS=1"
+#endif
+
+// BST_SUBTREE_STATS: every node keeps the live-key count and height of its
+// subtree, refreshed the same way as the Merkle hash. Collapsed-subtree summaries
+// and the selection panel read them instead of walking the subtree after every
+// edit. 8 bytes per node; visual build only, on by default there when it has
+// parent links.
+#ifndef BST_SUBTREE_STATS
+#define BST_SUBTREE_STATS (!BST_HEADLESS && BST_PARENT_LINKS)
+#endif
+#if BST_SUBTREE_STATS && !BST_PARENT_LINKS
+#error "BST_SUBTREE_STATS walks parent links up the modified path; build with BST_PARENT_LINKS=1"
+#endif
+#if BST_SUBTREE_STATS && BST_HEADLESS
+#error "BST_SUBTREE_STATS is visual-only: the headless node has no stats fields"
+#endif
+
+// BST_DEBUG_CHECKS: re-verify whole-tree invariants (parent links) after every
+// structural change. O(n) per change, so off by default even in debug builds.
+#ifndef BST_DEBUG_CHECKS
+#define BST_DEBUG_CHECKS 0
+#endif
+
+// BST_ARENA_SLOTS: node slots reserved (address space only) for the node arena.
+#ifndef BST_ARENA_SLOTS
+#define BST_ARENA_SLOTS (BST_HEADLESS ? (1u << 28) : (1u << 22))
+#endif
+
+// BST_ARENA_HUGEPAGES: back the node arena with 2 MB pages so random descents
+// through large trees stop missing the TLB. 0 = normal pages, 1 = transparent
+// huge pages (madvise), 2 = explicit hugetlb pages. Unavailable modes fall back
+// to the next lower one at runtime.
+#ifndef BST_ARENA_HUGEPAGES
+#define BST_ARENA_HUGEPAGES 1
+#endif
+
+// ---------- Node links ----------
+// Children and parents are 32-bit arena slot numbers rather than pointers
+// (slot 0 = null). NodeLink converts to and from Node* so tree code reads the
+// same as with raw pointers. The top two bits are a tag that survives
+// reassignment of the link; the left link's tag holds the optional balance field.
+struct Node;
+
+struct NodeLink {
+    static constexpr uint32_t INDEX_MASK = 0x3FFFFFFFu;
+    static constexpr uint32_t TAG_SHIFT = 30;
+    uint32_t bits = 0;
+
+    NodeLink() = default;
+    NodeLink(const NodeLink& other) : bits(other.bits & INDEX_MASK) {}
+    NodeLink& operator=(const NodeLink& other) { bits = (bits & ~INDEX_MASK) | (other.bits & INDEX_MASK); return *this; }
+    inline NodeLink& operator=(Node* n);
+    inline operator Node*() const;
+    inline Node* operator->() const;
+    uint32_t Slot() const { return bits & INDEX_MASK; }
+    uint32_t Tag() const { return bits >> TAG_SHIFT; }
+    void SetTag(uint32_t tag) { bits = (bits & INDEX_MASK) | (tag << TAG_SHIFT); }
+};
 
 // ---------- Node ----------
+// Signed 64-bit keys, so any long long typed or pasted into the input box fits.
+using Key = int64_t;
+
+inline uint64_t Mix64(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull; // splitmix64 finalizer
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Hash of a subtree from its root key and its children's hashes (0 = empty).
+inline uint64_t CombineDigest(Key key, uint64_t left, uint64_t right) {
+    return Mix64(Mix64((uint64_t)key) ^ (left * 0x9e3779b97f4a7c15ull) ^ ((right << 31) | (right >> 33)));
+}
+
+#if BST_HEADLESS
+struct alignas(16) Node {
+    Key value;
+    NodeLink left;
+    NodeLink right;
+#if BST_PARENT_LINKS
+    NodeLink parent;
+#endif
+#if BST_MERKLE
+    uint64_t merkle;
+    explicit Node(Key v = 0) : value(v), merkle(CombineDigest(v, 0, 0)) {}
+#else
+    explicit Node(Key v = 0) : value(v) {}
+#endif
+};
+static_assert(sizeof(Node) == (BST_PARENT_LINKS || BST_MERKLE ? 32 : 16), "headless node must be 16 bytes (4 per cache line), 32 with parent links or Merkle hashes");
+#else
 struct Node {
-    int value;
-    Node* left;
-    Node* right;
+    Key value;
+    NodeLink left;
+    NodeLink right;
+#if BST_PARENT_LINKS
+    NodeLink parent;
+#endif
     float x, y;        // target layout position
     float animX, animY;// animated position
     float radius;
     Color color;
-    Node(int v = 0, float _x = 0, float _y = 0) {
+    uint32_t layoutStamp; // layoutGeneration when x/y were last computed (lazy layout); 0 = never
+#if BST_SUBTREE_STATS
+    uint32_t subtreeLive;   // non-tombstoned keys in this subtree, this node included
+    uint32_t subtreeHeight; // levels in this subtree, 1 for a leaf
+#endif
+#if BST_MERKLE
+    uint64_t merkle;
+#endif
+    Node(Key v = 0, float _x = 0, float _y = 0) {
         value = v;
-        left = right = nullptr;
+#if BST_SUBTREE_STATS
+        subtreeLive = subtreeHeight = 1;
+#endif
+#if BST_MERKLE
+        merkle = CombineDigest(v, 0, 0);
+#endif
         x = animX = _x;
         y = animY = _y;
         radius = 25.0f;
         color = SKYBLUE;
+        layoutStamp = 0;
     }
 };
+#endif
 
-// ---------- Globals ----------
-static Node* root = nullptr;
-static const int SCREEN_W = 1400;
-static const int SCREEN_H = 900;
+// ---------- Node arena ----------
+// All nodes live in one contiguous block reserved up front and are addressed by
+// slot number. Addresses never move, so a Node* stays valid for the life of its
+// node; freed slots are recycled through a free list threaded over their left links.
+enum ArenaPageMode { ARENA_PAGES_NORMAL, ARENA_PAGES_TRANSPARENT_HUGE, ARENA_PAGES_EXPLICIT_HUGE };
 
-// ---------- Layout & animation helpers ----------
-void ComputePositions(Node* node, float cx, float cy, float offset) {
-    if (!node) return;
-    node->x = cx;
-    node->y = cy;
-    if (node->left) ComputePositions(node->left, cx - offset, cy + 90.0f, offset * 0.6f);
-    if (node->right) ComputePositions(node->right, cx + offset, cy + 90.0f, offset * 0.6f);
+struct NodeArena {
+    Node* base = nullptr;
+    void* mapping = nullptr;      // start of the OS reservation (base may be aligned inside it)
+    size_t mappingBytes = 0;
+    ArenaPageMode pages = ARENA_PAGES_NORMAL; // backing actually obtained
+    uint32_t capacity = 0;  // reserved slots
+    uint32_t committed = 0; // slots backed by memory (only Windows commits explicitly)
+    uint32_t top = 1;       // first never-used slot (slot 0 is the null link)
+    uint32_t freeHead = 0;  // most recently freed slot
+    uint32_t live = 0;      // nodes currently allocated
+};
+static NodeArena g_arena;
+
+// What the next ArenaInit asks for; the benchmark driver changes these between runs.
+struct ArenaConfig {
+    uint32_t slots = BST_ARENA_SLOTS;
+    ArenaPageMode pages = (ArenaPageMode)BST_ARENA_HUGEPAGES;
+};
+static ArenaConfig g_arenaConfig;
+
+inline Node* NodeAt(uint32_t slot) { return slot ? g_arena.base + slot : nullptr; }
+inline uint32_t SlotOf(const Node* n) { return n ? (uint32_t)(n - g_arena.base) : 0; }
+
+inline NodeLink& NodeLink::operator=(Node* n) { bits = (bits & ~INDEX_MASK) | SlotOf(n); return *this; }
+inline NodeLink::operator Node*() const { return NodeAt(bits & INDEX_MASK); }
+inline Node* NodeLink::operator->() const { return g_arena.base + (bits & INDEX_MASK); }
+
+// Optional per-node balance field in the left link's spare bits: stores -1..2
+// (an AVL balance factor, or a red-black colour) at no extra size.
+inline int GetBalance(const Node* n) { return (int)n->left.Tag() - 1; }
+inline void SetBalance(Node* n, int balance) { n->left.SetTag((uint32_t)(balance + 1)); }
+
+// Tombstone flag in the right link's spare bits: a lazily deleted node keeps its
+// place in the tree, is skipped by searches and is removed by PurgeTombstones.
+inline bool IsTombstone(const Node* n) { return (n->right.Tag() & 1u) != 0; }
+inline void SetTombstone(Node* n, bool dead) { n->right.SetTag((n->right.Tag() & ~1u) | (dead ? 1u : 0u)); }
+
+// Collapse flag (visualizer) in the next bit of the right link's tag; it flips
+// the default, so under auto-collapse a set flag means "expanded".
+inline bool HasCollapseFlag(const Node* n) { return (n->right.Tag() & 2u) != 0; }
+inline void SetCollapseFlag(Node* n, bool on) { n->right.SetTag((n->right.Tag() & ~2u) | (on ? 2u : 0u)); }
+
+static const size_t HUGE_PAGE_BYTES = 2u << 20;
+
+// Reserve address space for `slots` nodes with the requested page backing.
+// Windows large pages need SeLockMemoryPrivilege and cannot be reserved lazily,
+// so Windows always takes normal pages.
+bool ArenaReserve(uint32_t slots, ArenaPageMode pages) {
+    size_t bytes = (size_t)slots * sizeof(Node);
+#if defined(_WIN32)
+    void* mem = VirtualAlloc(nullptr, bytes, 0x2000 /*MEM_RESERVE*/, 0x04 /*PAGE_READWRITE*/);
+    if (!mem) return false;
+    g_arena.mapping = mem;
+    g_arena.mappingBytes = bytes;
+    g_arena.base = (Node*)mem;
+    g_arena.pages = ARENA_PAGES_NORMAL;
+    (void)pages;
+#else
+    bytes = (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    void* mem = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (pages == ARENA_PAGES_EXPLICIT_HUGE) {
+        // Needs pages in the hugetlb pool (vm.nr_hugepages); no NORESERVE, so a
+        // short pool fails here instead of faulting later.
+        mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            g_arena.mapping = mem;
+            g_arena.mappingBytes = bytes;
+            g_arena.base = (Node*)mem;
+            g_arena.pages = ARENA_PAGES_EXPLICIT_HUGE;
+        }
+        else pages = ARENA_PAGES_TRANSPARENT_HUGE;
+    }
+#endif
+    if (mem == MAP_FAILED) {
+        // Over-reserve by one huge page so the arena can start 2 MB aligned.
+        size_t mapBytes = bytes + (pages == ARENA_PAGES_NORMAL ? 0 : HUGE_PAGE_BYTES);
+        mem = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem == MAP_FAILED) return false;
+        g_arena.mapping = mem;
+        g_arena.mappingBytes = mapBytes;
+        g_arena.base = (Node*)mem;
+        g_arena.pages = ARENA_PAGES_NORMAL;
+#if defined(MADV_HUGEPAGE)
+        if (pages != ARENA_PAGES_NORMAL) {
+            uintptr_t aligned = ((uintptr_t)mem + HUGE_PAGE_BYTES - 1) & ~(uintptr_t)(HUGE_PAGE_BYTES - 1);
+            if (madvise((void*)aligned, bytes, MADV_HUGEPAGE) == 0) {
+                g_arena.base = (Node*)aligned;
+                g_arena.pages = ARENA_PAGES_TRANSPARENT_HUGE;
+            }
+        }
+#endif
+    }
+#endif
+    g_arena.capacity = slots;
+    g_arena.committed = 0;
+    return true;
 }
 
-void RecomputeLayoutAndSnap(Node* r) {
-    ComputePositions(r, SCREEN_W / 2.0f, 80.0f, 220.0f);
-    // Initialize anim positions if zero
-    std::function<void(Node*)> init = [&](Node* n) {
-        if (!n) return;
-        if (n->animX == 0 && n->animY == 0) {
-            n->animX = n->x; n->animY = n->y;
+// Reserve lazily on first use, halving the request until the OS accepts it
+// (32-bit builds cannot reserve the 64-bit default).
+void ArenaInit() {
+    uint32_t slots = std::min<uint32_t>(g_arenaConfig.slots, NodeLink::INDEX_MASK);
+    while (!ArenaReserve(slots, g_arenaConfig.pages)) {
+        slots /= 2;
+        if (slots < (1u << 16)) {
+            std::cerr << "node arena: cannot reserve memory" << std::endl;
+            std::abort();
         }
-        init(n->left); init(n->right);
-        };
-    init(r);
+    }
 }
 
-void SmoothMoveAll(Node* node, float easing = 0.18f) {
-    if (!node) return;
-    node->animX += (node->x - node->animX) * easing;
-    node->animY += (node->y - node->animY) * easing;
-    SmoothMoveAll(node->left, easing);
-    SmoothMoveAll(node->right, easing);
+// Return the whole reservation to the OS. Every node must already be dropped.
+void ArenaRelease() {
+    if (!g_arena.mapping) return;
+#if defined(_WIN32)
+    VirtualFree(g_arena.mapping, 0, 0x8000 /*MEM_RELEASE*/);
+#else
+    munmap(g_arena.mapping, g_arena.mappingBytes);
+#endif
+    g_arena = NodeArena();
 }
 
-// ---------- Drawing ----------
-void DrawTree(Node* node, Node* highlight = nullptr, Node* special = nullptr) {
-    if (!node) return;
-    if (node->left) DrawLineV({ node->animX, node->animY }, { node->left->animX, node->left->animY }, BLACK);
-    if (node->right) DrawLineV({ node->animX, node->animY }, { node->right->animX, node->right->animY }, BLACK);
+const char* ArenaPageModeName(ArenaPageMode pages) {
+    switch (pages) {
+    case ARENA_PAGES_TRANSPARENT_HUGE: return "transparent-huge";
+    case ARENA_PAGES_EXPLICIT_HUGE: return "explicit-huge";
+    default: return "normal";
+    }
+}
 
-    // Outer highlight ring (single)
-    if (node == highlight) {
-        DrawCircle((int)node->animX, (int)node->animY, node->radius + 6, YELLOW);
+Node* ArenaTakeSlot() {
+    if (!g_arena.base) ArenaInit();
+    uint32_t slot = g_arena.freeHead;
+    if (slot) {
+        g_arena.freeHead = g_arena.base[slot].left.bits;
     }
-    if (node == special) {
-        DrawCircle((int)node->animX, (int)node->animY, node->radius + 6, ORANGE);
+    else {
+        if (g_arena.top >= g_arena.capacity) {
+            std::cerr << "node arena: out of slots (" << g_arena.capacity << ")" << std::endl;
+            std::abort();
+        }
+        slot = g_arena.top++;
+#if defined(_WIN32)
+        if (slot >= g_arena.committed) {
+            uint32_t grow = std::min<uint32_t>(1u << 16, g_arena.capacity - g_arena.committed);
+            VirtualAlloc(g_arena.base + g_arena.committed, (size_t)grow * sizeof(Node), 0x1000 /*MEM_COMMIT*/, 0x04);
+            g_arena.committed += grow;
+        }
+#endif
+    }
+    g_arena.live++;
+    return g_arena.base + slot;
+}
+
+template <class... Args>
+Node* NewNode(Args&&... args) {
+    return new (ArenaTakeSlot()) Node(std::forward<Args>(args)...);
+}
+
+void FreeNode(Node* n) {
+    if (!n) return;
+    n->left.bits = g_arena.freeHead;
+    g_arena.freeHead = SlotOf(n);
+    g_arena.live--;
+}
+
+// Free a whole subtree (iterative: degenerate trees can be millions deep).
+void FreeTree(Node* n) {
+    std::vector<Node*> stack;
+    if (n) stack.push_back(n);
+    while (!stack.empty()) {
+        Node* cur = stack.back();
+        stack.pop_back();
+        if (cur->left) stack.push_back(cur->left);
+        if (cur->right) stack.push_back(cur->right);
+        FreeNode(cur);
     }
+}
+
+void DeleteNodePointer(Node*& ptr) {
+    if (!ptr) return;
+    FreeNode(ptr);
+    ptr = nullptr;
+}
+
+// ---------- Subtree aggregates ----------
+// Per-node values summarising the whole subtree: the Merkle hash (BST_MERKLE)
+// and the live count and height (BST_SUBTREE_STATS). Every structural change
+// ends with RefreshUp from the lowest node it touched (ReplaceChild and
+// LinkAtPath do it themselves); bulk builders call RefreshNode as they link,
+// children first. With neither option these are no-ops.
+#define BST_SUBTREE_AGGREGATES (BST_MERKLE || BST_SUBTREE_STATS)
+static const uint64_t MERKLE_TOMBSTONE_SALT = 0x5bd1e9955bd1e995ull;
+
+inline uint64_t MerkleOf(const Node* n) {
+#if BST_MERKLE
+    return n ? n->merkle : 0;
+#else
+    (void)n;
+    return 0;
+#endif
+}
+
+inline void RefreshNode(Node* n) {
+#if BST_MERKLE
+    n->merkle = CombineDigest(n->value, MerkleOf(n->left), MerkleOf(n->right)) ^ (IsTombstone(n) ? MERKLE_TOMBSTONE_SALT : 0);
+#endif
+#if BST_SUBTREE_STATS
+    const Node* l = n->left;
+    const Node* r = n->right;
+    n->subtreeLive = (IsTombstone(n) ? 0 : 1) + (l ? l->subtreeLive : 0) + (r ? r->subtreeLive : 0);
+    n->subtreeHeight = 1 + std::max(l ? l->subtreeHeight : 0, r ? r->subtreeHeight : 0);
+#endif
+    (void)n;
+}
+
+// n and every ancestor, O(depth).
+inline void RefreshUp(Node* n) {
+#if BST_SUBTREE_AGGREGATES
+    for (; n; n = n->parent) RefreshNode(n);
+#else
+    (void)n;
+#endif
+}
 
-    DrawCircle((int)node->animX, (int)node->animY, node->radius, node->color);
-    DrawCircleLines((int)node->animX, (int)node->animY, node->radius, DARKBLUE);
-    DrawText(std::to_string(node->value).c_str(), (int)(node->animX - 10), (int)(node->animY - 10), 20, BLACK);
+// Whole tree, post-order; for builders that link nodes top-down.
+void RefreshTree(Node* rootRef) {
+#if BST_SUBTREE_AGGREGATES
+    std::vector<std::pair<Node*, bool>> stack;
+    if (rootRef) stack.push_back({ rootRef, false });
+    while (!stack.empty()) {
+        auto [n, childrenDone] = stack.back();
+        stack.pop_back();
+        if (childrenDone) {
+            RefreshNode(n);
+            continue;
+        }
+        stack.push_back({ n, true });
+        if (n->right) stack.push_back({ n->right, false });
+        if (n->left) stack.push_back({ n->left, false });
+    }
+#else
+    (void)rootRef;
+#endif
+}
 
-    DrawTree(node->left, highlight, special);
-    DrawTree(node->right, highlight, special);
+// Same keys, tombstones and shape, in O(1). Always false without BST_MERKLE
+// unless both are the same tree.
+inline bool SameTree(const Node* a, const Node* b) {
+    return a == b || (BST_MERKLE && MerkleOf(a) == MerkleOf(b));
 }
 
 // ---------- Basic BST helpers ----------
-std::pair<Node*, Node*> FindWithParent(Node* rootRef, int value) {
+// Link helpers: every structural change goes through these so the parent links
+// (when enabled) never go stale.
+inline void SetLeft(Node* parent, Node* child) {
+    parent->left = child;
+#if BST_PARENT_LINKS
+    if (child) child->parent = parent;
+#endif
+}
+
+inline void SetRight(Node* parent, Node* child) {
+    parent->right = child;
+#if BST_PARENT_LINKS
+    if (child) child->parent = parent;
+#endif
+}
+
+std::pair<Node*, Node*> FindWithParent(Node* rootRef, Key value) {
     Node* parent = nullptr;
     Node* cur = rootRef;
     while (cur) {
-        if (value == cur->value) return { parent, cur };
+        // a tombstoned match is skipped; live duplicates can only sit to its right
+        if (value == cur->value && !IsTombstone(cur)) {
+#if BST_PARENT_LINKS
+            assert(cur->parent == parent);
+#endif
+            return { parent, cur };
+        }
         parent = cur;
         if (value < cur->value) cur = cur->left;
         else cur = cur->right;
@@ -113,239 +502,4541 @@ std::pair<Node*, Node*> FindInorderSuccessor(Node* node) {
     return { parent, cur };
 }
 
+std::pair<Node*, Node*> FindInorderPredecessor(Node* node) {
+    if (!node || !node->left) return { nullptr, nullptr };
+    Node* parent = node;
+    Node* cur = node->left;
+    while (cur->right) {
+        parent = cur;
+        cur = cur->right;
+    }
+    return { parent, cur };
+}
+
 void ReplaceChild(Node*& rootRef, Node* parent, Node* oldChild, Node* newChild) {
     if (!parent) {
         rootRef = newChild;
+#if BST_PARENT_LINKS
+        if (newChild) newChild->parent = nullptr;
+#endif
     }
     else {
-        if (parent->left == oldChild) parent->left = newChild;
-        else if (parent->right == oldChild) parent->right = newChild;
+        if (parent->left == oldChild) SetLeft(parent, newChild);
+        else if (parent->right == oldChild) SetRight(parent, newChild);
+        RefreshUp(parent);
     }
 }
 
-void DeleteNodePointer(Node*& ptr) {
-    if (!ptr) return;
-    delete ptr;
-    ptr = nullptr;
+// In-order neighbours. With parent links a full in-order walk is amortized O(1)
+// per step; without them each step re-descends from the root (O(height)).
+Node* InorderNext(Node* rootRef, Node* node) {
+    if (!node) return nullptr;
+    if (node->right) {
+        Node* cur = node->right;
+        while (cur->left) cur = cur->left;
+        return cur;
+    }
+#if BST_PARENT_LINKS
+    (void)rootRef;
+    Node* cur = node;
+    while (cur->parent && cur->parent->right == cur) cur = cur->parent;
+    return cur->parent;
+#else
+    Node* best = nullptr;
+    Node* cur = rootRef;
+    while (cur && cur != node) {
+        if (node->value < cur->value) { best = cur; cur = cur->left; }
+        else cur = cur->right;
+    }
+    return best;
+#endif
 }
 
-// ---------- Insert immediate helper (fallback) ----------
-void InsertValueImmediate(Node*& rootRef, int value) {
-    if (!rootRef) {
-        rootRef = new Node(value, SCREEN_W / 2.0f, 80.0f);
-        rootRef->color = RED;
-        RecomputeLayoutAndSnap(rootRef);
-        return;
+Node* InorderPrev(Node* rootRef, Node* node) {
+    if (!node) return nullptr;
+    if (node->left) {
+        Node* cur = node->left;
+        while (cur->right) cur = cur->right;
+        return cur;
     }
+#if BST_PARENT_LINKS
+    (void)rootRef;
+    Node* cur = node;
+    while (cur->parent && cur->parent->left == cur) cur = cur->parent;
+    return cur->parent;
+#else
+    Node* best = nullptr;
+    Node* cur = rootRef;
+    while (cur && cur != node) {
+        if (node->value < cur->value) cur = cur->left;
+        else { best = cur; cur = cur->right; }
+    }
+    return best;
+#endif
+}
+
+// Debug check run after every structural change with BST_DEBUG_CHECKS.
+bool CheckParentLinks(Node* node, Node* expectedParent = nullptr) {
+    if (!node) return true;
+#if BST_PARENT_LINKS
+    if (node->parent != expectedParent) return false;
+#else
+    (void)expectedParent;
+#endif
+    return CheckParentLinks(node->left, node) && CheckParentLinks(node->right, node);
+}
+
+// ---------- Path recording ----------
+// One root-to-leaf descent, shared by insert, delete and search and by the
+// overlays that draw their visited rings. Each operation owns one buffer and
+// refills it in place; capacity is reserved up front and only grows when the
+// tree gets deeper than any earlier path, so steady-state recording never allocates.
+struct PathBuffer {
+    std::vector<Node*> nodes; // visited nodes, root first
+    Node* found = nullptr;    // node holding the key (search/delete), nullptr if absent
+    Node* parent = nullptr;   // parent of `found`, or attach point for an insert
+    bool attachLeft = false;  // side of `parent` a new key would hang from
+
+    PathBuffer() { nodes.reserve(64); }
+    void clear() { nodes.clear(); found = nullptr; parent = nullptr; attachLeft = false; }
+    bool empty() const { return nodes.empty(); }
+    int size() const { return (int)nodes.size(); }
+    Node* operator[](int i) const { return nodes[i]; }
+    Node* back() const { return nodes.back(); }
+};
+
+// Descend from rootRef towards value, recording every visited node.
+// stopAtMatch: search/delete stop on an equal key; insert keeps going right so
+// duplicates attach below the existing key.
+void RecordPath(Node* rootRef, Key value, PathBuffer& path, bool stopAtMatch) {
+    path.clear();
     Node* cur = rootRef;
-    Node* parent = nullptr;
-    float offset = 220.0f;
-    float x = rootRef->x, y = rootRef->y;
     while (cur) {
-        parent = cur;
-        if (value < cur->value) {
-            x = cur->x - offset; y = cur->y + 90.0f;
-            cur = cur->left;
-        }
-        else {
-            x = cur->x + offset; y = cur->y + 90.0f;
-            cur = cur->right;
+        path.nodes.push_back(cur);
+        if (stopAtMatch && value == cur->value && !IsTombstone(cur)) {
+            path.found = cur;
+            return;
         }
-        offset *= 0.6f;
+        path.parent = cur;
+        path.attachLeft = value < cur->value;
+        cur = path.attachLeft ? cur->left : cur->right;
     }
-    Node* n = new Node(value, x, y);
-    n->color = RED;
-    if (value < parent->value) parent->left = n; else parent->right = n;
-    RecomputeLayoutAndSnap(rootRef);
 }
 
-// ---------- State machines: Insert, Delete, Search ----------
+// ---------- Shape analytics ----------
+struct ShapeStats {
+    size_t nodes = 0;
+    int height = 0;         // levels (empty tree = 0, single node = 1)
+    double avgDepth = 0.0;  // mean node depth, root = 0
+};
 
-// Insert state
-enum InsertStage { INS_IDLE, INS_TRAVERSING, INS_ATTACHING, INS_FINALIZE };
-static InsertStage insStage = INS_IDLE;
-static std::vector<Node*> insTraversalPath;
-static int insTraversalIndex = 0;
-static int insFramesCounter = 0;
-static const int INS_STEP_FRAMES = 12;
-static Node* insParent = nullptr;
-static Node* insNewNode = nullptr;
-static float insNewX = 0, insNewY = 0;
-static bool insNewIsLeft = false;
-static int insFinalizeTimer = 0; // frames to show blue after insertion
-static int insValuePending = 0;
+ShapeStats MeasureShape(Node* rootRef) {
+    ShapeStats st;
+    double depthSum = 0;
+    std::vector<std::pair<Node*, int>> stack;
+    if (rootRef) stack.push_back({ rootRef, 0 });
+    while (!stack.empty()) {
+        auto [n, d] = stack.back();
+        stack.pop_back();
+        st.nodes++;
+        depthSum += d;
+        st.height = std::max(st.height, d + 1);
+        if (n->left) stack.push_back({ n->left, d + 1 });
+        if (n->right) stack.push_back({ n->right, d + 1 });
+    }
+    st.avgDepth = st.nodes ? depthSum / (double)st.nodes : 0.0;
+    return st;
+}
 
-// Delete state
-enum DelStage {
-    DEL_IDLE, DEL_TRAVERSING, DEL_HIGHLIGHT_TARGET, DEL_HIGHLIGHT_SUCCESSOR,
-    DEL_MOVE_SUCCESSOR, DEL_MOVE_CHILD_UP, DEL_SHRINK_REMOVE, DEL_FINALIZE
-};
-static DelStage delStage = DEL_IDLE;
-static std::vector<Node*> delTraversalPath;
-static int delTraversalIndex = 0;
-static int delFramesCounter = 0;
-static const int DEL_STEP_FRAMES = 12;
-static Node* delTargetParent = nullptr;
-static Node* delTargetNode = nullptr;
-static Node* successorParent = nullptr;
-static Node* successorNode = nullptr;
-static Node* animNode = nullptr;
-static Node* animReplaceNode = nullptr;
-static float moveStartX = 0, moveStartY = 0, moveTargetX = 0, moveTargetY = 0;
-static float animDuration = 24.0f;
-static float animProgress = 0.0f;
-static int delValuePending = 0; // <-- pending delete value entered by user
+int TreeHeight(Node* rootRef) {
+    return MeasureShape(rootRef).height;
+}
 
-// Search state
-enum SearchStage { S_IDLE, S_TRAVERSING, S_FLASH_FOUND, S_FLASH_NOTFOUND };
-static SearchStage searchStage = S_IDLE;
-static std::vector<Node*> searchPath;
-static int searchIndex = 0;
-static int searchFrames = 0;
-static const int SEARCH_STEP_FRAMES = 12;
-static int flashCount = 0;
-static const int FLASH_FRAMES = 12; // frames per flash on/off
-static Node* searchFinalNode = nullptr;
-static int searchValuePending = 0; // <-- pending search value entered by user
+// ---------- Core operations (shared by the visual and headless builds) ----------
+// Hang n from the attach point recorded by RecordPath(..., stopAtMatch = false).
+void LinkAtPath(Node*& rootRef, const PathBuffer& path, Node* n) {
+    if (!path.parent) rootRef = n;
+    else if (path.attachLeft) SetLeft(path.parent, n);
+    else SetRight(path.parent, n);
+    RefreshUp(n);
+}
 
-// --- Status message (validations) ---
-static std::string statusMessage = "";
-static int statusTimer = 0; // frames: show message for 120 frames (2 sec)
+Node* InsertKey(Node*& rootRef, Key value, PathBuffer& path) {
+    RecordPath(rootRef, value, path, false);
+    Node* n = NewNode(value);
+    LinkAtPath(rootRef, path, n);
+    return n;
+}
 
-// ---------- Start insertion traversal (non-blocking) ----------
-void StartInsertion(int value) {
-    insTraversalPath.clear();
-    insTraversalIndex = 0;
-    insFramesCounter = 0;
-    insStage = INS_TRAVERSING;
-    insParent = nullptr;
-    insNewNode = nullptr;
-    insNewIsLeft = false;
-    insValuePending = value;
+// Two-children case: copy the in-order successor's key into target, then unlink
+// the successor (it has no left child) from succParent.
+void RemoveBySuccessorCopy(Node*& rootRef, Node* target, Node* succParent, Node* succ) {
+    target->value = succ->value;
+    SetTombstone(target, IsTombstone(succ));
+    ReplaceChild(rootRef, succParent, succ, succ->right);
+    FreeNode(succ);
+}
 
-    Node* cur = root;
-    Node* parent = nullptr;
-    float x = SCREEN_W / 2.0f;
-    float y = 80.0f;
-    float offset = 220.0f;
-
-    // if root null -> will create root directly
-    if (!cur) {
-        insParent = nullptr;
-        insNewX = x;
-        insNewY = y;
-        insNewIsLeft = false;
-        return;
+// Mirror image: copy the in-order predecessor's key, unlink the predecessor
+// (it has no right child). Callers must check PredecessorCopyKeepsOrder first.
+void RemoveByPredecessorCopy(Node*& rootRef, Node* target, Node* predParent, Node* pred) {
+    target->value = pred->value;
+    SetTombstone(target, IsTombstone(pred));
+    ReplaceChild(rootRef, predParent, pred, pred->left);
+    FreeNode(pred);
+}
+
+// Duplicates go right (left < node <= right). If another copy of the
+// predecessor's key stays in the left subtree, moving the key up would break
+// that, and the successor has to be used instead.
+bool PredecessorCopyKeepsOrder(Node* target, Node* predParent, Node* pred) {
+    Node* below = nullptr;
+    if (pred->left) {
+        below = pred->left;
+        while (below->right) below = below->right;
     }
+    else if (predParent != target) below = predParent;
+    return !below || below->value != pred->value;
+}
 
-    while (cur) {
-        insTraversalPath.push_back(cur);
-        parent = cur;
-        if (value < cur->value) {
-            x = cur->x - offset; y = cur->y + 90.0f;
-            cur = cur->left;
-            insNewIsLeft = true;
+// Two-children deletes: always taking the successor (Hibbard deletion) skews a
+// long insert/delete churn toward sqrt(n) height. The policy picks the side.
+enum DeletePolicy { DELETE_SUCCESSOR, DELETE_PREDECESSOR, DELETE_ALTERNATE, DELETE_RANDOM, DELETE_TALLER, DELETE_POLICY_COUNT };
+static DeletePolicy g_deletePolicy = DELETE_SUCCESSOR;
+static std::mt19937 g_deletePolicyRng(0x5eed);
+static unsigned g_deleteAlternate = 0;
+
+const char* DeletePolicyName(DeletePolicy policy) {
+    switch (policy) {
+    case DELETE_PREDECESSOR: return "predecessor";
+    case DELETE_ALTERNATE: return "alternating";
+    case DELETE_RANDOM: return "random";
+    case DELETE_TALLER: return "taller side";
+    default: return "successor";
+    }
+}
+
+// True: replace target (two children) from its right subtree (successor).
+// DELETE_TALLER measures both subtrees, O(size of target's subtree).
+bool ReplaceFromSuccessor(Node* target) {
+    bool useSuccessor = true;
+    switch (g_deletePolicy) {
+    case DELETE_PREDECESSOR: useSuccessor = false; break;
+    case DELETE_ALTERNATE: useSuccessor = (g_deleteAlternate++ & 1u) == 0; break;
+    case DELETE_RANDOM: useSuccessor = (g_deletePolicyRng() & 1u) == 0; break;
+    case DELETE_TALLER: useSuccessor = TreeHeight(target->right) >= TreeHeight(target->left); break;
+    default: break;
+    }
+    if (!useSuccessor) {
+        auto pr = FindInorderPredecessor(target);
+        if (!PredecessorCopyKeepsOrder(target, pr.first, pr.second)) useSuccessor = true;
+    }
+    return useSuccessor;
+}
+
+// Zero/one-child case: promote the only child (if any) into node's place.
+void SpliceOut(Node*& rootRef, Node* parent, Node* node) {
+    Node* child = node->left ? node->left : node->right;
+    ReplaceChild(rootRef, parent, node, child);
+    FreeNode(node);
+}
+
+bool DeleteKey(Node*& rootRef, Key value, PathBuffer& path) {
+    RecordPath(rootRef, value, path, true);
+    Node* target = path.found;
+    if (!target) return false;
+    if (target->left && target->right) {
+        if (ReplaceFromSuccessor(target)) {
+            auto pr = FindInorderSuccessor(target);
+            RemoveBySuccessorCopy(rootRef, target, pr.first, pr.second);
         }
         else {
-            x = cur->x + offset; y = cur->y + 90.0f;
-            cur = cur->right;
-            insNewIsLeft = false;
+            auto pr = FindInorderPredecessor(target);
+            RemoveByPredecessorCopy(rootRef, target, pr.first, pr.second);
         }
-        offset *= 0.6f;
     }
+    else {
+        SpliceOut(rootRef, path.parent, target);
+    }
+    return true;
+}
+
+// ---------- Arena compaction ----------
+// After long insert/delete churn, tree neighbours end up scattered across the
+// arena and freed slots leave holes. CompactArena rewrites every live node into
+// slots 1..live in breadth-first or van Emde Boas order so a descent touches
+// neighbouring memory, then rewrites all links. Any Node* held outside the
+// trees is invalid afterwards: only call it when no animation holds nodes.
+enum ArenaOrder { ARENA_ORDER_BFS, ARENA_ORDER_VEB };
 
-    insParent = parent;
-    insNewX = x; insNewY = y;
+// Freed-but-unused slots as a fraction of the slots ever handed out (O(1)).
+float ArenaHoleRatio() {
+    uint32_t used = g_arena.top - 1;
+    return used ? (float)(used - g_arena.live) / (float)used : 0.0f;
 }
 
-// Attach new node (called when traversal finished)
-void AttachNewNodeFromPending() {
-    Node* n = new Node(insValuePending, insNewX, insNewY);
-    n->color = RED;
-    if (!insParent) {
-        root = n;
+// Fraction of parent->child links that cross into a different 4 KB page.
+float MeasureLinkScatter(Node* rootRef) {
+    if (!rootRef) return 0.0f;
+    const size_t perPage = 4096 / sizeof(Node);
+    size_t links = 0, far = 0;
+    std::vector<Node*> stack{ rootRef };
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        for (Node* c : { (Node*)n->left, (Node*)n->right }) {
+            if (!c) continue;
+            links++;
+            if (SlotOf(n) / perPage != SlotOf(c) / perPage) far++;
+            stack.push_back(c);
+        }
     }
-    else {
-        if (insNewIsLeft) insParent->left = n;
-        else insParent->right = n;
+    return links ? (float)far / (float)links : 0.0f;
+}
+
+static void AppendBfsOrder(Node* rootRef, std::vector<Node*>& out) {
+    size_t head = out.size();
+    if (rootRef) out.push_back(rootRef);
+    while (head < out.size()) {
+        Node* n = out[head++];
+        if (n->left) out.push_back(n->left);
+        if (n->right) out.push_back(n->right);
     }
-    insNewNode = n;
-    RecomputeLayoutAndSnap(root);
-    // Start finalize timer (2 seconds)
-    insFinalizeTimer = 120;
-    // Set status message based on user-entered value
-    statusMessage = "Inserted " + std::to_string(insValuePending);
-    statusTimer = 120;
 }
 
-// ---------- Start deletion traversal (non-blocking) ----------
-void StartDeletion(int value) {
-    delTraversalPath.clear();
-    delTraversalIndex = 0;
-    delFramesCounter = 0;
-    delStage = DEL_TRAVERSING;
-    delTargetParent = nullptr;
-    delTargetNode = nullptr;
-    successorParent = nullptr;
-    successorNode = nullptr;
-    animNode = nullptr;
-    animReplaceNode = nullptr;
-    animProgress = 0;
+// vEB order for a tree of arbitrary shape: lay out the top half of the levels
+// recursively, then each subtree hanging below it.
+static void AppendVebOrder(Node* n, int levels, std::vector<Node*>& out) {
+    if (!n || levels <= 0) return;
+    if (levels == 1) { out.push_back(n); return; }
+    int top = levels / 2;
+    AppendVebOrder(n, top, out);
+    // frontier: nodes exactly `top` levels below n, left to right
+    std::vector<Node*> frontier{ n };
+    for (int d = 0; d < top && !frontier.empty(); ++d) {
+        std::vector<Node*> next;
+        next.reserve(frontier.size() * 2);
+        for (Node* f : frontier) {
+            if (f->left) next.push_back(f->left);
+            if (f->right) next.push_back(f->right);
+        }
+        frontier.swap(next);
+    }
+    for (Node* f : frontier) AppendVebOrder(f, levels - top, out);
+}
 
-    delValuePending = value;
+static void RemapLink(NodeLink& link, const std::vector<uint32_t>& remap) {
+    link.bits = (link.bits & ~NodeLink::INDEX_MASK) | remap[link.Slot()];
+}
 
-    Node* cur = root;
-    Node* parent = nullptr;
-    while (cur) {
-        delTraversalPath.push_back(cur);
-        if (value == cur->value) {
-            delTargetParent = parent;
-            delTargetNode = cur;
-            break;
-        }
-        parent = cur;
-        if (value < cur->value) cur = cur->left;
-        else cur = cur->right;
+// Relocate every node reachable from the given roots into the requested order
+// and update the roots. Nodes not reachable from any root are dropped.
+void CompactArena(std::initializer_list<Node**> roots, ArenaOrder order) {
+    std::vector<Node*> sequence;
+    sequence.reserve(g_arena.live);
+    for (Node** r : roots) {
+        if (order == ARENA_ORDER_BFS) AppendBfsOrder(*r, sequence);
+        else AppendVebOrder(*r, TreeHeight(*r), sequence);
     }
-    RecomputeLayoutAndSnap(root);
+
+    std::vector<uint32_t> remap(g_arena.top, 0);
+    for (size_t i = 0; i < sequence.size(); ++i) remap[SlotOf(sequence[i])] = (uint32_t)(i + 1);
+
+    // Copy out, then back in new order; raw copies keep the link tag bits.
+    std::vector<unsigned char> staging(sequence.size() * sizeof(Node));
+    for (size_t i = 0; i < sequence.size(); ++i) std::memcpy(&staging[i * sizeof(Node)], (void*)sequence[i], sizeof(Node));
+    for (size_t i = 0; i < sequence.size(); ++i) {
+        Node* dst = g_arena.base + i + 1;
+        std::memcpy((void*)dst, &staging[i * sizeof(Node)], sizeof(Node));
+        RemapLink(dst->left, remap);
+        RemapLink(dst->right, remap);
+#if BST_PARENT_LINKS
+        RemapLink(dst->parent, remap);
+#endif
+    }
+    for (Node** r : roots) *r = NodeAt(remap[SlotOf(*r)]);
+
+    uint32_t oldTop = g_arena.top;
+    g_arena.live = (uint32_t)sequence.size();
+    g_arena.top = g_arena.live + 1;
+    g_arena.freeHead = 0;
+#if !defined(_WIN32)
+    // Give the now-unused tail back to the OS.
+    uintptr_t tailStart = ((uintptr_t)(g_arena.base + g_arena.top) + 4095) & ~(uintptr_t)4095;
+    uintptr_t tailEnd = (uintptr_t)(g_arena.base + oldTop) & ~(uintptr_t)4095;
+    if (tailEnd > tailStart) madvise((void*)tailStart, tailEnd - tailStart, MADV_DONTNEED);
+#else
+    (void)oldTop;
+#endif
 }
 
-// ---------- Start search traversal ----------
-void StartSearch(int value) {
-    searchPath.clear();
-    searchIndex = 0;
-    searchFrames = 0;
-    flashCount = 0;
-    searchFinalNode = nullptr;
-    searchStage = S_TRAVERSING;
-    searchValuePending = value;
+// Compact when holes exceed `threshold` of the slots handed out. Returns true if it ran.
+bool MaybeCompactArena(std::initializer_list<Node**> roots, ArenaOrder order, float threshold) {
+    if (g_arena.live < 1024 || ArenaHoleRatio() < threshold) return false;
+    CompactArena(roots, order);
+    return true;
+}
+
+// ---------- Lazy deletion (tombstones) ----------
+// TombstoneKey marks the node dead in O(log n) without any relinking. Once dead
+// nodes pass TOMBSTONE_PURGE_RATIO of the tree, PurgeTombstones frees them all
+// and relinks the survivors as a balanced tree in one O(n) pass.
+static const float TOMBSTONE_PURGE_RATIO = 0.25f;
+
+bool TombstoneKey(Node* rootRef, Key value, PathBuffer& path, size_t& tombstones) {
+    RecordPath(rootRef, value, path, true);
+    if (!path.found) return false;
+    SetTombstone(path.found, true);
+    RefreshUp(path.found);
+    tombstones++;
+    return true;
+}
+
+void CollectInorder(Node* rootRef, std::vector<Node*>& out) {
+    std::vector<Node*> stack;
+    Node* cur = rootRef;
+    while (cur || !stack.empty()) {
+        while (cur) { stack.push_back(cur); cur = cur->left; }
+        cur = stack.back();
+        stack.pop_back();
+        out.push_back(cur);
+        cur = cur->right;
+    }
+}
+
+// Relink nodes[lo, hi) (already in key order) as a perfectly balanced subtree.
+Node* LinkBalanced(const std::vector<Node*>& nodes, size_t lo, size_t hi) {
+    if (lo >= hi) return nullptr;
+    size_t mid = lo + (hi - lo) / 2;
+    // equal keys must stay to the right (left < node <= right), so start the
+    // subtree at the first of a run of duplicates
+    while (mid > lo && nodes[mid - 1]->value == nodes[mid]->value) mid--;
+    Node* n = nodes[mid];
+    n->left = LinkBalanced(nodes, lo, mid);
+    n->right = LinkBalanced(nodes, mid + 1, hi);
+#if BST_PARENT_LINKS
+    if (n->left) n->left->parent = n;
+    if (n->right) n->right->parent = n;
+#endif
+    RefreshNode(n);
+    return n;
+}
+
+void PurgeTombstones(Node*& rootRef, size_t& tombstones) {
+    std::vector<Node*> nodes;
+    CollectInorder(rootRef, nodes);
+    size_t liveCount = 0;
+    for (Node* n : nodes) {
+        if (IsTombstone(n)) FreeNode(n);
+        else nodes[liveCount++] = n;
+    }
+    nodes.resize(liveCount);
+    rootRef = LinkBalanced(nodes, 0, nodes.size());
+#if BST_PARENT_LINKS
+    if (rootRef) rootRef->parent = nullptr;
+#endif
+    tombstones = 0;
+}
 
-    Node* cur = root;
+bool ShouldPurgeTombstones(size_t tombstones, size_t treeNodes) {
+    return tombstones > 0 && (float)tombstones >= TOMBSTONE_PURGE_RATIO * (float)treeNodes;
+}
+
+// ---------- Range delete ----------
+// Removes every key in [lo, hi] in O(height + k). Nodes outside the range keep
+// their place; at the first in-range node on the search path (the split node)
+// the two boundary paths below it are walked once, whole in-range subtrees are
+// detached as they are met, and the surviving pieces are spliced back.
+
+// Walk down `cur` keeping only keys on one side of `bound`; kept nodes are
+// chained along the opposite spine. Detached in-range pieces go to `detached`.
+static Node* TrimSide(Node* cur, Key bound, bool keepBelow, std::vector<Node*>& detached) {
+    Node* keptRoot = nullptr;
+    Node* keptTail = nullptr;
     while (cur) {
-        searchPath.push_back(cur);
-        if (value == cur->value) {
-            searchFinalNode = cur;
-            break;
+        bool keep = keepBelow ? cur->value < bound : cur->value > bound;
+        Node* next;
+        if (keep) {
+            // cur and its outer subtree stay; continue on the inner side
+            if (!keptTail) keptRoot = cur;
+            else if (keepBelow) SetRight(keptTail, cur);
+            else SetLeft(keptTail, cur);
+            keptTail = cur;
+            next = keepBelow ? cur->right : cur->left;
         }
-        if (value < cur->value) cur = cur->left;
-        else cur = cur->right;
+        else {
+            // cur and its inner subtree are all in range: detach as one piece
+            next = keepBelow ? cur->left : cur->right;
+            if (keepBelow) cur->left = nullptr; else cur->right = nullptr;
+            detached.push_back(cur);
+        }
+        cur = next;
+    }
+    if (keptTail) {
+        if (keepBelow) keptTail->right = nullptr; else keptTail->left = nullptr;
+    }
+#if BST_PARENT_LINKS
+    if (keptRoot) keptRoot->parent = nullptr;
+#endif
+    return keptRoot;
+}
+
+// Returns how many nodes were removed; tombstoned ones are also taken off `tombstones`.
+size_t DeleteRange(Node*& rootRef, Key lo, Key hi, size_t& tombstones) {
+    if (lo > hi) return 0;
+    Node* parent = nullptr;
+    Node* split = rootRef;
+    while (split && (split->value < lo || split->value > hi)) {
+        parent = split;
+        split = split->value < lo ? split->right : split->left;
+    }
+    if (!split) return 0;
+
+    std::vector<Node*> detached;
+    Node* below = TrimSide(split->left, lo, true, detached);
+    Node* above = TrimSide(split->right, hi, false, detached);
+    split->left = nullptr;
+    split->right = nullptr;
+    detached.push_back(split);
+
+    // every key in `below` is < lo <= hi < every key in `above`
+    Node* joined = below;
+    if (!below) joined = above;
+    else if (above) {
+        Node* maxBelow = below;
+        while (maxBelow->right) maxBelow = maxBelow->right;
+        SetRight(maxBelow, above);
+    }
+    ReplaceChild(rootRef, parent, split, joined);
+#if BST_SUBTREE_AGGREGATES
+    // every kept boundary node sits on the seam: below's right spine, then above's left spine
+    Node* seam = nullptr;
+    if (above) for (seam = above; seam->left; seam = seam->left) {}
+    else if (below) for (seam = below; seam->right; seam = seam->right) {}
+    RefreshUp(seam);
+#endif
+
+    // hand the detached subtrees back to the arena in one sweep
+    size_t removed = 0;
+    std::vector<Node*> stack;
+    for (Node* piece : detached) {
+        stack.push_back(piece);
+        while (!stack.empty()) {
+            Node* n = stack.back();
+            stack.pop_back();
+            if (n->left) stack.push_back(n->left);
+            if (n->right) stack.push_back(n->right);
+            if (IsTombstone(n)) tombstones--;
+            FreeNode(n);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+// ---------- Tree generators ----------
+// Build a test tree of n distinct keys in one pass instead of n inserts.
+// GEN_RANDOM has the shape of a BST built by inserting a random permutation
+// (a Cartesian tree over random priorities, O(n) after sampling); GEN_BALANCED
+// is the perfectly balanced tree over the same keys.
+enum GenShape { GEN_RANDOM, GEN_BALANCED };
+
+const char* GenShapeName(GenShape shape) {
+    return shape == GEN_BALANCED ? "balanced" : "random";
+}
+
+// n distinct keys in ascending order drawn uniformly from [0, 4n) (selection sampling).
+static void SampleSortedKeys(size_t n, std::mt19937_64& rng, std::vector<Key>& keys) {
+    keys.clear();
+    keys.reserve(n);
+    uint64_t range = 4 * (uint64_t)n;
+    size_t needed = n;
+    for (uint64_t k = 0; k < range && needed; ++k) {
+        if (rng() % (range - k) < needed) {
+            keys.push_back((Key)k);
+            needed--;
+        }
+    }
+}
+
+// Frees the old tree first; the caller lays out / snaps positions once afterwards.
+void GenerateTree(Node*& rootRef, size_t n, uint64_t seed, GenShape shape) {
+    FreeTree(rootRef);
+    rootRef = nullptr;
+    if (n == 0) return;
+    std::mt19937_64 rng(seed);
+    std::vector<Key> keys;
+    SampleSortedKeys(n, rng, keys);
+    std::vector<Node*> nodes(n);
+    for (size_t i = 0; i < n; ++i) nodes[i] = NewNode(keys[i]);
+
+    if (shape == GEN_BALANCED) {
+        rootRef = LinkBalanced(nodes, 0, n);
+    }
+    else {
+        // keys arrive sorted; keep the right spine of the min-heap on priorities
+        std::vector<uint64_t> priority(n);
+        for (uint64_t& p : priority) p = rng();
+        std::vector<size_t> spine;
+        for (size_t i = 0; i < n; ++i) {
+            Node* below = nullptr;
+            while (!spine.empty() && priority[spine.back()] > priority[i]) {
+                below = nodes[spine.back()];
+                spine.pop_back();
+            }
+            SetLeft(nodes[i], below);
+            if (!spine.empty()) SetRight(nodes[spine.back()], nodes[i]);
+            spine.push_back(i);
+        }
+        rootRef = nodes[spine.front()];
+        RefreshTree(rootRef);
+    }
+#if BST_PARENT_LINKS
+    rootRef->parent = nullptr;
+#endif
+}
+
+// ---------- Task pool ----------
+// Fixed worker threads draining one queue of fork-join tasks. Invoke(a, b) runs
+// a on the calling thread and queues b; while b is unfinished the caller runs
+// queued tasks itself, so nested Invokes never leave every thread blocked.
+struct TaskPool {
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> queue; // guarded by mtx
+    bool stopping = false;                   // guarded by mtx
+
+    explicit TaskPool(unsigned count) {
+        for (unsigned i = 0; i < count; ++i) threads.emplace_back([this] { Work(); });
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : threads) t.join();
+    }
+
+    // Worker threads plus the thread calling Invoke.
+    unsigned Concurrency() const { return (unsigned)threads.size() + 1; }
+
+    void Push(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Runs one queued task on the calling thread; false if there was none.
+    bool RunOne() {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (queue.empty()) return false;
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    void Work() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+
+    template <typename A, typename B>
+    void Invoke(A&& a, B&& b) {
+        std::atomic<bool> done{ false };
+        Push([&] {
+            b();
+            done.store(true, std::memory_order_release);
+        });
+        a();
+        while (!done.load(std::memory_order_acquire))
+            if (!RunOne()) std::this_thread::yield();
+    }
+};
+
+// Shared pool, one thread per hardware thread (the caller being one of them).
+TaskPool& SharedTaskPool() {
+    static TaskPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+// ---------- Join-based set operations ----------
+// Union, intersection and difference of two trees by divide and conquer:
+// split one tree by the other's root key, recurse on both sides (in parallel
+// near the top), and join the results. Both inputs must be treaps whose heap
+// priority is a hash of the key: the shape is then unique for a key set and
+// balanced in expectation, and the operations take O(m log(n/m + 1)) expected
+// work for sizes m <= n. They consume their inputs, reusing nodes: nothing is
+// allocated or freed in the tasks. Subtrees left out of the result are handed
+// back for the caller to free (FreeTree), which costs O(size dropped).
+enum SetOp { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+
+const char* SetOpName(SetOp op) {
+    switch (op) {
+    case SET_INTERSECTION: return "intersection";
+    case SET_DIFFERENCE: return "difference";
+    default: return "union";
+    }
+}
+
+inline uint64_t TreapPriority(Key key) { return Mix64((uint64_t)key); }
+
+// Max-heap on priority; equal priorities only come from equal keys.
+inline bool TreapAbove(const Node* a, const Node* b) {
+    return TreapPriority(a->value) > TreapPriority(b->value);
+}
+
+// Links sorted, distinct-key nodes into their treap in O(n) (right-spine stack).
+Node* LinkTreap(const std::vector<Node*>& nodes) {
+    std::vector<Node*> spine;
+    for (Node* n : nodes) {
+        Node* below = nullptr;
+        while (!spine.empty() && TreapAbove(n, spine.back())) {
+            below = spine.back();
+            spine.pop_back();
+        }
+        SetLeft(n, below);
+        n->right = nullptr;
+        if (!spine.empty()) SetRight(spine.back(), n);
+        spine.push_back(n);
+    }
+    if (spine.empty()) return nullptr;
+#if BST_PARENT_LINKS
+    spine.front()->parent = nullptr;
+#endif
+    RefreshTree(spine.front());
+    return spine.front();
+}
+
+// A treap copy of the live keys of any BST (duplicates kept once).
+Node* CopyAsTreap(Node* rootRef) {
+    std::vector<Node*> inorder, nodes;
+    CollectInorder(rootRef, inorder);
+    nodes.reserve(inorder.size());
+    for (Node* n : inorder)
+        if (!IsTombstone(n) && (nodes.empty() || nodes.back()->value != n->value)) nodes.push_back(NewNode(n->value));
+    return LinkTreap(nodes);
+}
+
+// Splits t into keys < key and keys > key; returns the node holding key, detached, if any.
+Node* TreapSplit(Node* t, Key key, Node*& less, Node*& greater) {
+    if (!t) {
+        less = greater = nullptr;
+        return nullptr;
+    }
+    Node* found;
+    if (key == t->value) {
+        less = t->left;
+        greater = t->right;
+        t->left = nullptr;
+        t->right = nullptr;
+        found = t;
+    }
+    else if (key < t->value) {
+        Node* inner;
+        found = TreapSplit(t->left, key, less, inner);
+        SetLeft(t, inner);
+        RefreshNode(t);
+        greater = t;
+    }
+    else {
+        Node* inner;
+        found = TreapSplit(t->right, key, inner, greater);
+        SetRight(t, inner);
+        RefreshNode(t);
+        less = t;
+    }
+    return found;
+}
+
+// Joins treaps with every key of l below every key of r.
+Node* TreapJoin(Node* l, Node* r) {
+    if (!l) return r;
+    if (!r) return l;
+    if (TreapAbove(l, r)) {
+        SetRight(l, TreapJoin(l->right, r));
+        RefreshNode(l);
+        return l;
+    }
+    SetLeft(r, TreapJoin(l, r->left));
+    RefreshNode(r);
+    return r;
+}
+
+struct SetOpContext {
+    SetOp op;
+    TaskPool* pool;       // null = sequential
+    int parallelDepth;    // fork only this many levels deep
+};
+
+// garbage collects subtrees to free afterwards (freeing inside tasks would race on the arena).
+Node* SetOpRecurse(const SetOpContext& ctx, Node* a, Node* b, int depth, std::vector<Node*>& garbage) {
+    if (!a || !b) {
+        Node* dropped = ctx.op == SET_UNION ? nullptr : (ctx.op == SET_INTERSECTION ? (a ? a : b) : b);
+        if (dropped) garbage.push_back(dropped);
+        if (ctx.op == SET_UNION) return a ? a : b;
+        return ctx.op == SET_INTERSECTION ? nullptr : a;
+    }
+    // the root with the higher priority stays on top; difference is not symmetric
+    bool swapped = ctx.op != SET_DIFFERENCE && TreapAbove(b, a);
+    if (swapped) std::swap(a, b);
+    Node* less;
+    Node* greater;
+    Node* match = TreapSplit(b, a->value, less, greater);
+    Node* l;
+    Node* r;
+    if (ctx.pool && depth < ctx.parallelDepth) {
+        std::vector<Node*> rightGarbage;
+        ctx.pool->Invoke([&] { l = SetOpRecurse(ctx, a->left, less, depth + 1, garbage); },
+                         [&] { r = SetOpRecurse(ctx, a->right, greater, depth + 1, rightGarbage); });
+        garbage.insert(garbage.end(), rightGarbage.begin(), rightGarbage.end());
+    }
+    else {
+        l = SetOpRecurse(ctx, a->left, less, depth + 1, garbage);
+        r = SetOpRecurse(ctx, a->right, greater, depth + 1, garbage);
+    }
+    bool keep = ctx.op == SET_UNION || (ctx.op == SET_INTERSECTION ? match != nullptr : match == nullptr);
+    if (match) garbage.push_back(match);
+    if (!keep) {
+        a->left = nullptr;
+        a->right = nullptr;
+        garbage.push_back(a);
+        return TreapJoin(l, r);
+    }
+    SetLeft(a, l);
+    SetRight(a, r);
+    RefreshNode(a);
+    return a;
+}
+
+// Consumes a and b (treaps from CopyAsTreap / LinkTreap) and returns the result
+// treap; dropped gets the roots of the subtrees left out. pool = null runs
+// sequentially.
+Node* SetOperation(SetOp op, Node* a, Node* b, TaskPool* pool, std::vector<Node*>& dropped) {
+    int parallelDepth = 0;
+    if (pool)
+        while ((1u << parallelDepth) < 4 * pool->Concurrency()) parallelDepth++; // a few tasks per thread
+    SetOpContext ctx{ op, pool, parallelDepth };
+    Node* result = SetOpRecurse(ctx, a, b, 0, dropped);
+#if BST_PARENT_LINKS
+    if (result) result->parent = nullptr;
+#endif
+    return result;
+}
+
+// Baseline: walk both trees in order, merge the two key streams, and link the
+// surviving nodes into a treap. O(n + m) whatever the sizes. Consumes a and b
+// and hands back dropped nodes like SetOperation.
+Node* SetOperationByMerge(SetOp op, Node* a, Node* b, std::vector<Node*>& dropped) {
+    std::vector<Node*> left, right, kept;
+    CollectInorder(a, left);
+    CollectInorder(b, right);
+    kept.reserve(op == SET_INTERSECTION ? std::min(left.size(), right.size()) : left.size() + (op == SET_UNION ? right.size() : 0));
+    size_t i = 0, j = 0;
+    while (i < left.size() || j < right.size()) {
+        if (j == right.size() || (i < left.size() && left[i]->value < right[j]->value)) {
+            (op == SET_INTERSECTION ? dropped : kept).push_back(left[i++]);
+        }
+        else if (i == left.size() || right[j]->value < left[i]->value) {
+            (op == SET_UNION ? kept : dropped).push_back(right[j++]);
+        }
+        else { // in both
+            (op == SET_DIFFERENCE ? dropped : kept).push_back(left[i++]);
+            dropped.push_back(right[j++]);
+        }
+    }
+    for (Node* n : dropped) {
+        n->left = nullptr;
+        n->right = nullptr;
+    }
+    return LinkTreap(kept);
+}
+
+// ---------- Structural diff ----------
+// Keys added and removed between two treaps (see set operations), skipping
+// every pair of subtrees that are the same node or hash the same. Treap shape
+// is a function of the key set, so an unchanged region of the tree is an
+// identical subtree on both sides; equal trees diff in O(1) from the root
+// digests, and d changes cost about O(d log n). Digests are computed once per
+// snapshot (O(n)) and looked up by key, so they survive arena compaction; with
+// BST_MERKLE the hashes stored in the nodes are used instead.
+struct SubtreeDigest {
+    uint64_t hash; // same value as the node's Merkle hash (no tombstones here)
+    size_t size;
+};
+using DigestIndex = std::unordered_map<Key, SubtreeDigest>;
+
+// Post-order over the whole tree; returns the root's digest.
+SubtreeDigest DigestTree(Node* rootRef, DigestIndex& index) {
+    index.clear();
+    index.reserve(MeasureShape(rootRef).nodes);
+    SubtreeDigest empty{ 0, 0 };
+    std::vector<std::pair<Node*, bool>> stack;
+    if (rootRef) stack.push_back({ rootRef, false });
+    while (!stack.empty()) {
+        auto [n, childrenDone] = stack.back();
+        stack.pop_back();
+        if (!childrenDone) {
+            stack.push_back({ n, true });
+            if (n->right) stack.push_back({ n->right, false });
+            if (n->left) stack.push_back({ n->left, false });
+            continue;
+        }
+        const SubtreeDigest& l = n->left ? index.at(n->left->value) : empty;
+        const SubtreeDigest& r = n->right ? index.at(n->right->value) : empty;
+        index[n->value] = { CombineDigest(n->value, l.hash, r.hash), l.size + r.size + 1 };
+    }
+    return rootRef ? index.at(rootRef->value) : empty;
+}
+
+struct TreeDiff {
+    std::vector<Key> added, removed;
+    std::vector<Key> changed;     // keys in both whose subtree on the new side differs
+    size_t identicalSubtrees = 0; // skipped pairs
+    size_t identicalNodes = 0;    // nodes under them (counted from digests only)
+    size_t visited = 0;           // node pairs compared
+};
+
+struct DiffSide {
+    const DigestIndex* digests; // null: read the nodes' Merkle hashes
+    std::vector<Key>* only;     // keys found only on this side
+
+    uint64_t Hash(const Node* n) const { return digests ? digests->at(n->value).hash : MerkleOf(n); }
+    size_t Size(const Node* n) const { return digests ? digests->at(n->value).size : 0; }
+};
+
+// Every key of n's subtree in (lo, hi), in order.
+static void CollectRange(Node* n, Key lo, Key hi, bool loOpen, bool hiOpen, std::vector<Key>& out) {
+    if (!n) return;
+    bool aboveLo = loOpen || n->value > lo, belowHi = hiOpen || n->value < hi;
+    if (aboveLo) CollectRange(n->left, lo, hi, loOpen, hiOpen, out);
+    if (aboveLo && belowHi) out.push_back(n->value);
+    if (belowHi) CollectRange(n->right, lo, hi, loOpen, hiOpen, out);
+}
+
+// Compares the keys of a and b inside the open interval (lo, hi) (unbounded
+// where loOpen / hiOpen). Restricted to an interval a treap is still a treap,
+// rooted at the first node inside it on the way down.
+static void DiffRange(Node* a, Node* b, Key lo, Key hi, bool loOpen, bool hiOpen, DiffSide sa, DiffSide sb, TreeDiff& out) {
+    auto inside = [&](Node* n) { return (loOpen || n->value > lo) && (hiOpen || n->value < hi); };
+    while (a && !inside(a)) a = (!loOpen && a->value <= lo) ? a->right : a->left;
+    while (b && !inside(b)) b = (!loOpen && b->value <= lo) ? b->right : b->left;
+    if (!a || !b) {
+        if (a) CollectRange(a, lo, hi, loOpen, hiOpen, *sa.only);
+        if (b) CollectRange(b, lo, hi, loOpen, hiOpen, *sb.only);
+        return;
+    }
+    out.visited++;
+    // a shared node or equal hashes: the same keys below, so also inside (lo, hi)
+    if (a == b || sa.Hash(a) == sb.Hash(b)) {
+        out.identicalSubtrees++;
+        out.identicalNodes += sa.Size(a);
+        return;
+    }
+    if (a->value == b->value) {
+        out.changed.push_back(a->value);
+        DiffRange(a->left, b->left, lo, a->value, loOpen, false, sa, sb, out);
+        DiffRange(a->right, b->right, a->value, hi, false, hiOpen, sa, sb, out);
+        return;
+    }
+    // the root with the higher priority cannot be on the other side at all
+    bool fromA = TreapAbove(a, b);
+    Node* top = fromA ? a : b;
+    (fromA ? sa : sb).only->push_back(top->value);
+    DiffRange(fromA ? (Node*)a->left : a, fromA ? b : (Node*)b->left, lo, top->value, loOpen, false, sa, sb, out);
+    DiffRange(fromA ? (Node*)a->right : a, fromA ? b : (Node*)b->right, top->value, hi, false, hiOpen, sa, sb, out);
+}
+
+// added / removed come out sorted. Null digests (BST_MERKLE builds only) read the
+// hashes kept in the nodes.
+void DiffTreaps(Node* oldRoot, const DigestIndex* oldDigests, Node* newRoot, const DigestIndex* newDigests, TreeDiff& out) {
+    assert(BST_MERKLE || (oldDigests && newDigests));
+    out = TreeDiff();
+    DiffRange(oldRoot, newRoot, 0, 0, true, true, { oldDigests, &out.removed }, { newDigests, &out.added }, out);
+    std::sort(out.added.begin(), out.added.end());
+    std::sort(out.removed.begin(), out.removed.end());
+}
+
+// ---------- Comparison engines ----------
+// Self-contained ordered-set engines for the side-by-side comparison mode: plain
+// BST, AVL, red-black and splay, plus a B+ tree, a skip list and a radix tree.
+// Each owns its nodes (heap pointers, outside the main arena, so every engine
+// can run on its own thread) and counts key comparisons (byte steps for the
+// radix tree) and restructurings (rotations; page splits and merges for the
+// B+ tree; relinked pointers for the skip list; node resizes for the radix
+// tree). Set semantics: inserting a present key is a no-op.
+enum EngineKind { ENGINE_PLAIN_BST, ENGINE_AVL, ENGINE_RED_BLACK, ENGINE_SPLAY, ENGINE_BPLUS, ENGINE_SKIP_LIST, ENGINE_RADIX, ENGINE_KIND_COUNT };
+
+const char* EngineKindName(EngineKind kind) {
+    switch (kind) {
+    case ENGINE_AVL: return "AVL";
+    case ENGINE_RED_BLACK: return "Red-black";
+    case ENGINE_SPLAY: return "Splay";
+    case ENGINE_BPLUS: return "B+ tree";
+    case ENGINE_SKIP_LIST: return "Skip list";
+    case ENGINE_RADIX: return "Radix tree";
+    default: return "Plain BST";
+    }
+}
+
+// What the engine's restructure counter counts.
+const char* EngineRestructureName(EngineKind kind) {
+    switch (kind) {
+    case ENGINE_BPLUS: return "splits/merges";
+    case ENGINE_SKIP_LIST: return "relinks";
+    case ENGINE_RADIX: return "resizes";
+    default: return "rotations";
+    }
+}
+
+struct CmpNode {
+    Key key;
+    CmpNode* left = nullptr;
+    CmpNode* right = nullptr;
+    CmpNode* parent = nullptr;
+    int height = 1;   // AVL
+    bool red = true;  // red-black (new nodes start red)
+    explicit CmpNode(Key k) : key(k) {}
+};
+
+struct OrderedEngine {
+    EngineKind kind;
+    CmpNode* root = nullptr;
+    size_t size = 0;
+    uint64_t comparisons = 0;
+    uint64_t rotations = 0;
+
+    explicit OrderedEngine(EngineKind k) : kind(k) {}
+    ~OrderedEngine() { Clear(); }
+    OrderedEngine(const OrderedEngine&) = delete;
+    OrderedEngine& operator=(const OrderedEngine&) = delete;
+
+    // ----- shared structure helpers -----
+    static int H(CmpNode* n) { return n ? n->height : 0; }
+    static bool IsRed(CmpNode* n) { return n && n->red; }
+    static void UpdateHeight(CmpNode* n) { n->height = 1 + std::max(H(n->left), H(n->right)); }
+    static CmpNode* Min(CmpNode* n) { while (n->left) n = n->left; return n; }
+    static CmpNode* Max(CmpNode* n) { while (n->right) n = n->right; return n; }
+
+    void Transplant(CmpNode* u, CmpNode* v) {
+        if (!u->parent) root = v;
+        else if (u == u->parent->left) u->parent->left = v;
+        else u->parent->right = v;
+        if (v) v->parent = u->parent;
+    }
+
+    void RotateLeft(CmpNode* x) {
+        CmpNode* y = x->right;
+        x->right = y->left;
+        if (y->left) y->left->parent = x;
+        Transplant(x, y);
+        y->left = x;
+        x->parent = y;
+        rotations++;
+        if (kind == ENGINE_AVL) { UpdateHeight(x); UpdateHeight(y); }
+    }
+
+    void RotateRight(CmpNode* x) {
+        CmpNode* y = x->left;
+        x->left = y->right;
+        if (y->right) y->right->parent = x;
+        Transplant(x, y);
+        y->right = x;
+        x->parent = y;
+        rotations++;
+        if (kind == ENGINE_AVL) { UpdateHeight(x); UpdateHeight(y); }
+    }
+
+    // Descend towards key; returns the match, or nullptr with `last` = last node visited.
+    CmpNode* Find(Key key, CmpNode*& last) {
+        last = nullptr;
+        CmpNode* cur = root;
+        while (cur) {
+            comparisons++;
+            last = cur;
+            if (key == cur->key) return cur;
+            cur = key < cur->key ? cur->left : cur->right;
+        }
+        return nullptr;
+    }
+
+    // ----- operations -----
+    bool Contains(Key key) {
+        CmpNode* last;
+        CmpNode* hit = Find(key, last);
+        if (kind == ENGINE_SPLAY && last) Splay(last);
+        return hit != nullptr;
+    }
+
+    bool Insert(Key key) {
+        CmpNode* parent;
+        if (CmpNode* hit = Find(key, parent)) {
+            if (kind == ENGINE_SPLAY) Splay(hit);
+            return false;
+        }
+        CmpNode* n = new CmpNode(key);
+        n->parent = parent;
+        if (!parent) root = n;
+        else if (key < parent->key) parent->left = n;
+        else parent->right = n;
+        size++;
+        switch (kind) {
+        case ENGINE_AVL: RebalanceUp(parent); break;
+        case ENGINE_RED_BLACK: InsertFixup(n); break;
+        case ENGINE_SPLAY: Splay(n); break;
+        default: break;
+        }
+        return true;
+    }
+
+    bool Erase(Key key) {
+        CmpNode* last;
+        CmpNode* z = Find(key, last);
+        if (!z) {
+            if (kind == ENGINE_SPLAY && last) Splay(last);
+            return false;
+        }
+        size--;
+        if (kind == ENGINE_SPLAY) { SplayErase(z); return true; }
+        if (kind == ENGINE_RED_BLACK) { RedBlackErase(z); return true; }
+
+        // plain BST / AVL: successor is moved into place (no key copy)
+        CmpNode* rebalanceFrom;
+        if (!z->left) { rebalanceFrom = z->parent; Transplant(z, z->right); }
+        else if (!z->right) { rebalanceFrom = z->parent; Transplant(z, z->left); }
+        else {
+            CmpNode* y = Min(z->right);
+            if (y->parent != z) {
+                rebalanceFrom = y->parent;
+                Transplant(y, y->right);
+                y->right = z->right;
+                y->right->parent = y;
+            }
+            else rebalanceFrom = y;
+            Transplant(z, y);
+            y->left = z->left;
+            y->left->parent = y;
+            y->height = z->height;
+        }
+        delete z;
+        if (kind == ENGINE_AVL) RebalanceUp(rebalanceFrom);
+        return true;
+    }
+
+    int Height() const {
+        int height = 0;
+        std::vector<std::pair<CmpNode*, int>> stack;
+        if (root) stack.push_back({ root, 1 });
+        while (!stack.empty()) {
+            auto [n, d] = stack.back();
+            stack.pop_back();
+            height = std::max(height, d);
+            if (n->left) stack.push_back({ n->left, d + 1 });
+            if (n->right) stack.push_back({ n->right, d + 1 });
+        }
+        return height;
+    }
+
+    void Clear() {
+        std::vector<CmpNode*> stack;
+        if (root) stack.push_back(root);
+        while (!stack.empty()) {
+            CmpNode* n = stack.back();
+            stack.pop_back();
+            if (n->left) stack.push_back(n->left);
+            if (n->right) stack.push_back(n->right);
+            delete n;
+        }
+        root = nullptr;
+        size = 0;
+    }
+
+    // ----- AVL -----
+    void RebalanceUp(CmpNode* n) {
+        while (n) {
+            UpdateHeight(n);
+            int balance = H(n->left) - H(n->right);
+            if (balance > 1) {
+                if (H(n->left->left) < H(n->left->right)) RotateLeft(n->left);
+                RotateRight(n);
+                n = n->parent; // new subtree root
+            }
+            else if (balance < -1) {
+                if (H(n->right->right) < H(n->right->left)) RotateRight(n->right);
+                RotateLeft(n);
+                n = n->parent;
+            }
+            n = n->parent;
+        }
+    }
+
+    // ----- red-black (CLRS, nullptr leaves are black) -----
+    void InsertFixup(CmpNode* z) {
+        while (IsRed(z->parent)) {
+            CmpNode* p = z->parent;
+            CmpNode* g = p->parent;
+            if (p == g->left) {
+                CmpNode* u = g->right;
+                if (IsRed(u)) { p->red = false; u->red = false; g->red = true; z = g; }
+                else {
+                    if (z == p->right) { z = p; RotateLeft(z); p = z->parent; }
+                    p->red = false;
+                    g->red = true;
+                    RotateRight(g);
+                }
+            }
+            else {
+                CmpNode* u = g->left;
+                if (IsRed(u)) { p->red = false; u->red = false; g->red = true; z = g; }
+                else {
+                    if (z == p->left) { z = p; RotateRight(z); p = z->parent; }
+                    p->red = false;
+                    g->red = true;
+                    RotateLeft(g);
+                }
+            }
+        }
+        root->red = false;
+    }
+
+    void RedBlackErase(CmpNode* z) {
+        CmpNode* y = z;
+        bool removedRed = y->red;
+        CmpNode* x;
+        CmpNode* xParent;
+        if (!z->left) { x = z->right; xParent = z->parent; Transplant(z, z->right); }
+        else if (!z->right) { x = z->left; xParent = z->parent; Transplant(z, z->left); }
+        else {
+            y = Min(z->right);
+            removedRed = y->red;
+            x = y->right;
+            if (y->parent == z) xParent = y;
+            else {
+                xParent = y->parent;
+                Transplant(y, y->right);
+                y->right = z->right;
+                y->right->parent = y;
+            }
+            Transplant(z, y);
+            y->left = z->left;
+            y->left->parent = y;
+            y->red = z->red;
+        }
+        delete z;
+        if (!removedRed) EraseFixup(x, xParent);
+    }
+
+    void EraseFixup(CmpNode* x, CmpNode* parent) {
+        while (x != root && !IsRed(x)) {
+            if (x == parent->left) {
+                CmpNode* w = parent->right;
+                if (IsRed(w)) { w->red = false; parent->red = true; RotateLeft(parent); w = parent->right; }
+                if (!IsRed(w->left) && !IsRed(w->right)) { w->red = true; x = parent; parent = x->parent; }
+                else {
+                    if (!IsRed(w->right)) { w->left->red = false; w->red = true; RotateRight(w); w = parent->right; }
+                    w->red = parent->red;
+                    parent->red = false;
+                    if (w->right) w->right->red = false;
+                    RotateLeft(parent);
+                    x = root;
+                }
+            }
+            else {
+                CmpNode* w = parent->left;
+                if (IsRed(w)) { w->red = false; parent->red = true; RotateRight(parent); w = parent->left; }
+                if (!IsRed(w->left) && !IsRed(w->right)) { w->red = true; x = parent; parent = x->parent; }
+                else {
+                    if (!IsRed(w->left)) { w->right->red = false; w->red = true; RotateLeft(w); w = parent->left; }
+                    w->red = parent->red;
+                    parent->red = false;
+                    if (w->left) w->left->red = false;
+                    RotateRight(parent);
+                    x = root;
+                }
+            }
+        }
+        if (x) x->red = false;
+    }
+
+    // ----- splay (bottom-up) -----
+    void Splay(CmpNode* x) {
+        while (x->parent) {
+            CmpNode* p = x->parent;
+            CmpNode* g = p->parent;
+            if (!g) {
+                if (x == p->left) RotateRight(p); else RotateLeft(p);
+            }
+            else if ((x == p->left) == (p == g->left)) { // zig-zig
+                if (x == p->left) { RotateRight(g); RotateRight(p); }
+                else { RotateLeft(g); RotateLeft(p); }
+            }
+            else { // zig-zag
+                if (x == p->left) { RotateRight(p); RotateLeft(g); }
+                else { RotateLeft(p); RotateRight(g); }
+            }
+        }
+    }
+
+    void SplayErase(CmpNode* z) {
+        Splay(z);
+        CmpNode* l = z->left;
+        CmpNode* r = z->right;
+        delete z;
+        if (l) l->parent = nullptr;
+        if (r) r->parent = nullptr;
+        if (!l) { root = r; return; }
+        root = l;
+        Splay(Max(l));
+        root->right = r;
+        if (r) r->parent = root;
+    }
+};
+
+// ---------- B+ tree engine ----------
+// Keys live only in the leaf pages, which are chained in key order, so a range
+// scan is one descent plus a walk along the chain. Inner pages hold separators:
+// child i covers keys in [keys[i - 1], keys[i]). Pages split above maxKeys and
+// borrow from or merge with a sibling below maxKeys / 2.
+struct BPlusPage {
+    bool leaf;
+    std::vector<Key> keys;
+    std::vector<BPlusPage*> children; // inner pages: keys.size() + 1
+    BPlusPage* next = nullptr;        // leaf chain
+    explicit BPlusPage(bool isLeaf) : leaf(isLeaf) {}
+};
+
+struct BPlusTree {
+    static const int DEFAULT_PAGE_KEYS = 16;
+
+    BPlusPage* root = nullptr;
+    size_t size = 0;
+    int levels = 0;
+    int maxKeys;
+    uint64_t comparisons = 0;
+    uint64_t restructures = 0; // splits + merges
+
+    explicit BPlusTree(int pageKeys = DEFAULT_PAGE_KEYS) : maxKeys(std::max(pageKeys, 3)) {}
+    ~BPlusTree() { Clear(); }
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    int MinKeys() const { return maxKeys / 2; }
+
+    // First position in keys whose key is >= key (upper: > key), counting comparisons.
+    size_t Search(const std::vector<Key>& keys, Key key, bool upper) {
+        size_t lo = 0, hi = keys.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            comparisons++;
+            if (upper ? keys[mid] <= key : keys[mid] < key) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    BPlusPage* LeafFor(Key key) {
+        BPlusPage* page = root;
+        while (page && !page->leaf) page = page->children[Search(page->keys, key, true)];
+        return page;
+    }
+
+    bool Contains(Key key) {
+        BPlusPage* leaf = LeafFor(key);
+        if (!leaf) return false;
+        size_t pos = Search(leaf->keys, key, false);
+        return pos < leaf->keys.size() && leaf->keys[pos] == key;
+    }
+
+    // Calls visit(key) for every key in [lo, hi] in order; returns how many.
+    template <typename Visit>
+    size_t RangeScan(Key lo, Key hi, Visit&& visit) {
+        size_t count = 0;
+        BPlusPage* leaf = LeafFor(lo);
+        if (!leaf) return 0;
+        for (size_t pos = Search(leaf->keys, lo, false); leaf; leaf = leaf->next, pos = 0) {
+            for (; pos < leaf->keys.size(); ++pos) {
+                if (leaf->keys[pos] > hi) return count;
+                visit(leaf->keys[pos]);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    bool Insert(Key key) {
+        if (!root) {
+            root = new BPlusPage(true);
+            levels = 1;
+        }
+        Key upKey = 0;
+        BPlusPage* split = nullptr;
+        if (!InsertInto(root, key, upKey, split)) return false;
+        if (split) { // the root split: grow by one level
+            BPlusPage* top = new BPlusPage(false);
+            top->keys.push_back(upKey);
+            top->children = { root, split };
+            root = top;
+            levels++;
+        }
+        size++;
+        return true;
+    }
+
+    bool Erase(Key key) {
+        if (!root || !EraseFrom(root, key)) return false;
+        size--;
+        if (!root->leaf && root->keys.empty()) { // the root's last two children merged
+            BPlusPage* old = root;
+            root = root->children[0];
+            delete old;
+            levels--;
+        }
+        else if (root->leaf && root->keys.empty()) {
+            delete root;
+            root = nullptr;
+            levels = 0;
+        }
+        return true;
+    }
+
+    int Height() const { return levels; }
+
+    void Clear() {
+        std::vector<BPlusPage*> stack;
+        if (root) stack.push_back(root);
+        while (!stack.empty()) {
+            BPlusPage* page = stack.back();
+            stack.pop_back();
+            for (BPlusPage* child : page->children) stack.push_back(child);
+            delete page;
+        }
+        root = nullptr;
+        size = 0;
+        levels = 0;
+    }
+
+    // On overflow, `split` is the new right sibling and upKey its separator.
+    bool InsertInto(BPlusPage* page, Key key, Key& upKey, BPlusPage*& split) {
+        split = nullptr;
+        if (page->leaf) {
+            size_t pos = Search(page->keys, key, false);
+            if (pos < page->keys.size() && page->keys[pos] == key) return false;
+            page->keys.insert(page->keys.begin() + pos, key);
+            if ((int)page->keys.size() > maxKeys) {
+                size_t mid = page->keys.size() / 2;
+                split = new BPlusPage(true);
+                split->keys.assign(page->keys.begin() + mid, page->keys.end());
+                page->keys.resize(mid);
+                split->next = page->next;
+                page->next = split;
+                upKey = split->keys.front();
+                restructures++;
+            }
+            return true;
+        }
+        size_t i = Search(page->keys, key, true);
+        Key childUp = 0;
+        BPlusPage* childSplit = nullptr;
+        if (!InsertInto(page->children[i], key, childUp, childSplit)) return false;
+        if (childSplit) {
+            page->keys.insert(page->keys.begin() + i, childUp);
+            page->children.insert(page->children.begin() + i + 1, childSplit);
+            if ((int)page->keys.size() > maxKeys) { // the middle separator moves up
+                size_t mid = page->keys.size() / 2;
+                split = new BPlusPage(false);
+                upKey = page->keys[mid];
+                split->keys.assign(page->keys.begin() + mid + 1, page->keys.end());
+                split->children.assign(page->children.begin() + mid + 1, page->children.end());
+                page->keys.resize(mid);
+                page->children.resize(mid + 1);
+                restructures++;
+            }
+        }
+        return true;
+    }
+
+    bool EraseFrom(BPlusPage* page, Key key) {
+        if (page->leaf) {
+            size_t pos = Search(page->keys, key, false);
+            if (pos == page->keys.size() || page->keys[pos] != key) return false;
+            page->keys.erase(page->keys.begin() + pos);
+            return true;
+        }
+        size_t i = Search(page->keys, key, true);
+        if (!EraseFrom(page->children[i], key)) return false;
+        if ((int)page->children[i]->keys.size() < MinKeys()) Rebalance(page, i);
+        return true;
+    }
+
+    // children[i] underflowed: borrow a key from a sibling that can spare one,
+    // otherwise merge with a sibling.
+    void Rebalance(BPlusPage* parent, size_t i) {
+        BPlusPage* child = parent->children[i];
+        BPlusPage* left = i > 0 ? parent->children[i - 1] : nullptr;
+        BPlusPage* right = i + 1 < parent->children.size() ? parent->children[i + 1] : nullptr;
+        if (left && (int)left->keys.size() > MinKeys()) {
+            if (child->leaf) {
+                child->keys.insert(child->keys.begin(), left->keys.back());
+                parent->keys[i - 1] = child->keys.front();
+            }
+            else {
+                child->keys.insert(child->keys.begin(), parent->keys[i - 1]);
+                parent->keys[i - 1] = left->keys.back();
+                child->children.insert(child->children.begin(), left->children.back());
+                left->children.pop_back();
+            }
+            left->keys.pop_back();
+        }
+        else if (right && (int)right->keys.size() > MinKeys()) {
+            if (child->leaf) {
+                child->keys.push_back(right->keys.front());
+                right->keys.erase(right->keys.begin());
+                parent->keys[i] = right->keys.front();
+            }
+            else {
+                child->keys.push_back(parent->keys[i]);
+                parent->keys[i] = right->keys.front();
+                right->keys.erase(right->keys.begin());
+                child->children.push_back(right->children.front());
+                right->children.erase(right->children.begin());
+            }
+        }
+        else Merge(parent, left ? i - 1 : i);
+    }
+
+    // Fold children[i + 1] into children[i].
+    void Merge(BPlusPage* parent, size_t i) {
+        BPlusPage* left = parent->children[i];
+        BPlusPage* right = parent->children[i + 1];
+        if (left->leaf) left->next = right->next;
+        else left->keys.push_back(parent->keys[i]);
+        left->keys.insert(left->keys.end(), right->keys.begin(), right->keys.end());
+        left->children.insert(left->children.end(), right->children.begin(), right->children.end());
+        right->children.clear();
+        delete right;
+        parent->keys.erase(parent->keys.begin() + i);
+        parent->children.erase(parent->children.begin() + i + 1);
+        restructures++;
+    }
+};
+
+// ---------- Skip list engine ----------
+// Sorted linked list with express lanes: a node with a tower of L levels is
+// linked into the lists of levels 0..L-1, and each level keeps about half the
+// nodes of the one below (towers are drawn from a seeded RNG). A search runs
+// along the top lane and drops a level whenever the next key would overshoot.
+struct SkipNode {
+    Key key;
+    int levels;
+    SkipNode* next[1]; // allocated with `levels` entries
+
+    static SkipNode* Make(Key key, int levels) {
+        void* mem = ::operator new(sizeof(SkipNode) + sizeof(SkipNode*) * (size_t)(levels - 1));
+        SkipNode* node = static_cast<SkipNode*>(mem);
+        node->key = key;
+        node->levels = levels;
+        for (int i = 0; i < levels; ++i) node->next[i] = nullptr;
+        return node;
+    }
+};
+
+// One stop of a search: the node stood on (head = the list head) and the lane.
+struct SkipStep {
+    Key key;
+    int level;
+    bool head;
+};
+
+struct SkipList {
+    static const int MAX_LEVELS = 32;
+
+    SkipNode* head;
+    int levels = 1; // lanes in use
+    size_t size = 0;
+    uint64_t comparisons = 0;
+    uint64_t relinks = 0; // next pointers written by inserts and erases
+    std::mt19937 rng;
+
+    explicit SkipList(unsigned seed = 0x5eed) : head(SkipNode::Make(0, MAX_LEVELS)), rng(seed) {}
+    ~SkipList() {
+        Clear();
+        ::operator delete(head);
+    }
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    int RandomLevels() {
+        uint32_t bits = rng();
+        int l = 1;
+        while (l < MAX_LEVELS && (bits & 1u)) {
+            l++;
+            bits >>= 1;
+        }
+        return l;
+    }
+
+    // Last node before key on every lane into update[] (if given); returns the
+    // first node >= key on level 0. trace, if given, gets every stop.
+    SkipNode* Descend(Key key, SkipNode** update, std::vector<SkipStep>* trace) {
+        SkipNode* cur = head;
+        for (int l = levels - 1; l >= 0; --l) {
+            if (trace) trace->push_back({ cur->key, l, cur == head });
+            while (cur->next[l]) {
+                comparisons++;
+                if (cur->next[l]->key >= key) break;
+                cur = cur->next[l];
+                if (trace) trace->push_back({ cur->key, l, false });
+            }
+            if (update) update[l] = cur;
+        }
+        return cur->next[0];
+    }
+
+    bool Contains(Key key, std::vector<SkipStep>* trace = nullptr) {
+        SkipNode* n = Descend(key, nullptr, trace);
+        bool found = n && n->key == key;
+        if (found && trace) trace->push_back({ key, 0, false });
+        return found;
+    }
+
+    bool Insert(Key key) {
+        SkipNode* update[MAX_LEVELS];
+        SkipNode* n = Descend(key, update, nullptr);
+        if (n && n->key == key) return false;
+        int l = RandomLevels();
+        for (; levels < l; ++levels) update[levels] = head;
+        SkipNode* node = SkipNode::Make(key, l);
+        for (int i = 0; i < l; ++i) {
+            node->next[i] = update[i]->next[i];
+            update[i]->next[i] = node;
+        }
+        relinks += 2 * (uint64_t)l;
+        size++;
+        return true;
+    }
+
+    bool Erase(Key key) {
+        SkipNode* update[MAX_LEVELS];
+        SkipNode* n = Descend(key, update, nullptr);
+        if (!n || n->key != key) return false;
+        for (int i = 0; i < n->levels; ++i) update[i]->next[i] = n->next[i];
+        relinks += (uint64_t)n->levels;
+        ::operator delete(n);
+        while (levels > 1 && !head->next[levels - 1]) levels--;
+        size--;
+        return true;
+    }
+
+    // Calls visit(key) for every key in [lo, hi] in order; returns how many.
+    template <typename Visit>
+    size_t RangeScan(Key lo, Key hi, Visit&& visit) {
+        size_t count = 0;
+        for (SkipNode* n = Descend(lo, nullptr, nullptr); n && n->key <= hi; n = n->next[0]) {
+            visit(n->key);
+            count++;
+        }
+        return count;
+    }
+
+    int Height() const { return size ? levels : 0; }
+
+    void Clear() {
+        for (SkipNode* n = head->next[0]; n;) {
+            SkipNode* next = n->next[0];
+            ::operator delete(n);
+            n = next;
+        }
+        for (int i = 0; i < MAX_LEVELS; ++i) head->next[i] = nullptr;
+        levels = 1;
+        size = 0;
+    }
+};
+
+// ---------- Radix tree engine ----------
+// Adaptive radix tree over the key's bytes, most significant first, with the
+// sign bit flipped so byte order is key order. A lookup costs one step per
+// byte that actually branches, whatever n is: at most 8, and 4 for 32-bit keys
+// once the upper bytes they share sit in the root's prefix. Inner nodes grow
+// 4 -> 16 -> 48 -> 256 children and shrink back. Each keeps its full key
+// prefix, so a node left with one child is simply replaced by it, and a key
+// is kept as a leaf at the first byte where it differs from its neighbours.
+enum RadixKind : uint8_t { RADIX_N4, RADIX_N16, RADIX_N48, RADIX_N256 };
+
+// A child word: 0 = empty; bit 0 = leaf with the key stored inline (keys that
+// fit in 63 bits); bit 1 = pointer to a boxed key; otherwise an inner node.
+using RadixChild = uintptr_t;
+
+struct RadixInner {
+    RadixKind kind;
+    uint8_t depth;  // byte this node branches on (0 = most significant)
+    uint16_t count;
+    uint64_t prefix; // key bits above depth; lower bytes zero
+};
+struct RadixN4 : RadixInner { uint8_t keys[4]; RadixChild children[4]; };
+struct RadixN16 : RadixInner { uint8_t keys[16]; RadixChild children[16]; };
+struct RadixN48 : RadixInner { uint8_t slot[256]; RadixChild children[48]; }; // slot: 0 = none, else index + 1
+struct RadixN256 : RadixInner { RadixChild children[256]; };
+
+struct RadixTree {
+    RadixChild root = 0;
+    size_t size = 0;
+    uint64_t comparisons = 0; // byte steps plus the final key check
+    uint64_t resizes = 0;     // nodes created, grown, shrunk or folded away
+    size_t bytes = 0;         // inner nodes and boxed keys
+
+    RadixTree() = default;
+    ~RadixTree() { Clear(); }
+    RadixTree(const RadixTree&) = delete;
+    RadixTree& operator=(const RadixTree&) = delete;
+
+    static uint64_t Bits(Key k) { return (uint64_t)k ^ (1ull << 63); }
+    static unsigned Byte(uint64_t u, int depth) { return (unsigned)(u >> (56 - 8 * depth)) & 0xffu; }
+    static uint64_t PrefixMask(int depth) { return depth ? ~0ull << (64 - 8 * depth) : 0; }
+    static int FirstDiffByte(uint64_t a, uint64_t b) {
+        int d = 0;
+        while (d < 7 && Byte(a, d) == Byte(b, d)) d++;
+        return d;
+    }
+    static int Capacity(RadixKind kind) {
+        static const int caps[] = { 4, 16, 48, 256 };
+        return caps[kind];
+    }
+
+    static bool IsLeaf(RadixChild c) { return (c & 3u) != 0; }
+    static RadixInner* Inner(RadixChild c) { return reinterpret_cast<RadixInner*>(c); }
+    static Key LeafKey(RadixChild c) {
+        return (c & 1u) ? (Key)((int64_t)c >> 1) : *reinterpret_cast<const Key*>(c & ~(RadixChild)3);
+    }
+
+    RadixChild MakeLeaf(Key k) {
+        RadixChild packed = (RadixChild)((uint64_t)k << 1) | 1u;
+        if (LeafKey(packed) == k) return packed;
+        bytes += sizeof(Key);
+        return reinterpret_cast<RadixChild>(new Key(k)) | 2u;
+    }
+
+    void FreeLeaf(RadixChild c) {
+        if (c & 1u) return;
+        bytes -= sizeof(Key);
+        delete reinterpret_cast<Key*>(c & ~(RadixChild)3);
+    }
+
+    RadixInner* NewInner(RadixKind kind, int depth, uint64_t prefix) {
+        RadixInner* n;
+        switch (kind) {
+        case RADIX_N4: n = new RadixN4(); bytes += sizeof(RadixN4); break;
+        case RADIX_N16: n = new RadixN16(); bytes += sizeof(RadixN16); break;
+        case RADIX_N48: n = new RadixN48(); bytes += sizeof(RadixN48); break;
+        default: n = new RadixN256(); bytes += sizeof(RadixN256); break;
+        }
+        n->kind = kind;
+        n->depth = (uint8_t)depth;
+        n->count = 0;
+        n->prefix = prefix;
+        resizes++;
+        return n;
+    }
+
+    void FreeInner(RadixInner* n) {
+        switch (n->kind) {
+        case RADIX_N4: bytes -= sizeof(RadixN4); delete static_cast<RadixN4*>(n); break;
+        case RADIX_N16: bytes -= sizeof(RadixN16); delete static_cast<RadixN16*>(n); break;
+        case RADIX_N48: bytes -= sizeof(RadixN48); delete static_cast<RadixN48*>(n); break;
+        default: bytes -= sizeof(RadixN256); delete static_cast<RadixN256*>(n); break;
+        }
+    }
+
+    template <typename N>
+    static RadixChild* FindSorted(N* n, unsigned b) {
+        for (int i = 0; i < n->count; ++i)
+            if (n->keys[i] == b) return &n->children[i];
+        return nullptr;
+    }
+
+    static RadixChild* FindChild(RadixInner* n, unsigned b) {
+        switch (n->kind) {
+        case RADIX_N4: return FindSorted(static_cast<RadixN4*>(n), b);
+        case RADIX_N16: return FindSorted(static_cast<RadixN16*>(n), b);
+        case RADIX_N48: {
+            RadixN48* m = static_cast<RadixN48*>(n);
+            return m->slot[b] ? &m->children[m->slot[b] - 1] : nullptr;
+        }
+        default: {
+            RadixN256* m = static_cast<RadixN256*>(n);
+            return m->children[b] ? &m->children[b] : nullptr;
+        }
+        }
+    }
+
+    // Calls f(byte, child) for every child in byte order.
+    template <typename F>
+    static void ForEachChild(RadixInner* n, F&& f) {
+        switch (n->kind) {
+        case RADIX_N4: {
+            RadixN4* m = static_cast<RadixN4*>(n);
+            for (int i = 0; i < m->count; ++i) f(m->keys[i], m->children[i]);
+            break;
+        }
+        case RADIX_N16: {
+            RadixN16* m = static_cast<RadixN16*>(n);
+            for (int i = 0; i < m->count; ++i) f(m->keys[i], m->children[i]);
+            break;
+        }
+        case RADIX_N48: {
+            RadixN48* m = static_cast<RadixN48*>(n);
+            for (unsigned b = 0; b < 256; ++b)
+                if (m->slot[b]) f(b, m->children[m->slot[b] - 1]);
+            break;
+        }
+        default: {
+            RadixN256* m = static_cast<RadixN256*>(n);
+            for (unsigned b = 0; b < 256; ++b)
+                if (m->children[b]) f(b, m->children[b]);
+        }
+        }
+    }
+
+    template <typename N>
+    static void PutSorted(N* n, unsigned b, RadixChild c) {
+        int i = n->count;
+        for (; i > 0 && n->keys[i - 1] > b; --i) {
+            n->keys[i] = n->keys[i - 1];
+            n->children[i] = n->children[i - 1];
+        }
+        n->keys[i] = (uint8_t)b;
+        n->children[i] = c;
+        n->count++;
+    }
+
+    // Adds a child to a node with room for it.
+    static void Put(RadixInner* n, unsigned b, RadixChild c) {
+        switch (n->kind) {
+        case RADIX_N4: PutSorted(static_cast<RadixN4*>(n), b, c); break;
+        case RADIX_N16: PutSorted(static_cast<RadixN16*>(n), b, c); break;
+        case RADIX_N48: {
+            RadixN48* m = static_cast<RadixN48*>(n);
+            m->children[m->count] = c;
+            m->slot[b] = (uint8_t)(m->count + 1);
+            m->count++;
+            break;
+        }
+        default:
+            static_cast<RadixN256*>(n)->children[b] = c;
+            n->count++;
+        }
+    }
+
+    RadixInner* Resize(RadixInner* n, RadixKind kind) {
+        RadixInner* m = NewInner(kind, n->depth, n->prefix);
+        ForEachChild(n, [&](unsigned b, RadixChild c) { Put(m, b, c); });
+        FreeInner(n);
+        return m;
+    }
+
+    // ref is the word that points at n; it is rewritten if n grows.
+    void AddChild(RadixChild& ref, RadixInner* n, unsigned b, RadixChild c) {
+        if (n->count == Capacity(n->kind)) {
+            n = Resize(n, (RadixKind)(n->kind + 1));
+            ref = reinterpret_cast<RadixChild>(n);
+        }
+        Put(n, b, c);
+    }
+
+    template <typename N>
+    static void RemoveSorted(N* n, unsigned b) {
+        int i = 0;
+        while (n->keys[i] != b) i++;
+        for (; i + 1 < n->count; ++i) {
+            n->keys[i] = n->keys[i + 1];
+            n->children[i] = n->children[i + 1];
+        }
+    }
+
+    // Drops child b of n, shrinking n (or replacing it by its last child).
+    void RemoveChild(RadixChild& ref, RadixInner* n, unsigned b) {
+        switch (n->kind) {
+        case RADIX_N4: RemoveSorted(static_cast<RadixN4*>(n), b); break;
+        case RADIX_N16: RemoveSorted(static_cast<RadixN16*>(n), b); break;
+        case RADIX_N48: {
+            RadixN48* m = static_cast<RadixN48*>(n);
+            int index = m->slot[b] - 1, last = m->count - 1;
+            m->slot[b] = 0;
+            if (index != last) { // keep children packed: move the last one into the hole
+                m->children[index] = m->children[last];
+                for (unsigned other = 0; other < 256; ++other)
+                    if (m->slot[other] == last + 1) { m->slot[other] = (uint8_t)(index + 1); break; }
+            }
+            break;
+        }
+        default: static_cast<RadixN256*>(n)->children[b] = 0;
+        }
+        n->count--;
+        if (n->kind == RADIX_N4 && n->count == 1) {
+            ref = static_cast<RadixN4*>(n)->children[0];
+            FreeInner(n);
+            resizes++;
+        }
+        else if (n->kind == RADIX_N16 && n->count <= 3) ref = reinterpret_cast<RadixChild>(Resize(n, RADIX_N4));
+        else if (n->kind == RADIX_N48 && n->count <= 12) ref = reinterpret_cast<RadixChild>(Resize(n, RADIX_N16));
+        else if (n->kind == RADIX_N256 && n->count <= 37) ref = reinterpret_cast<RadixChild>(Resize(n, RADIX_N48));
+    }
+
+    bool Contains(Key key) {
+        uint64_t u = Bits(key);
+        RadixChild c = root;
+        while (c && !IsLeaf(c)) { // prefixes are not checked on the way down; the leaf is
+            RadixInner* n = Inner(c);
+            comparisons++;
+            RadixChild* next = FindChild(n, Byte(u, n->depth));
+            c = next ? *next : 0;
+        }
+        if (!c) return false;
+        comparisons++;
+        return LeafKey(c) == key;
+    }
+
+    bool Insert(Key key) {
+        uint64_t u = Bits(key);
+        RadixChild* ref = &root;
+        for (;;) {
+            RadixChild c = *ref;
+            if (!c) {
+                *ref = MakeLeaf(key);
+                break;
+            }
+            comparisons++;
+            uint64_t other; // a key (or prefix) this one must branch away from
+            if (IsLeaf(c)) {
+                if (LeafKey(c) == key) return false;
+                other = Bits(LeafKey(c));
+            }
+            else {
+                RadixInner* n = Inner(c);
+                if (((u ^ n->prefix) & PrefixMask(n->depth)) == 0) {
+                    unsigned b = Byte(u, n->depth);
+                    RadixChild* next = FindChild(n, b);
+                    if (next) {
+                        ref = next;
+                        continue;
+                    }
+                    AddChild(*ref, n, b, MakeLeaf(key));
+                    break;
+                }
+                other = n->prefix;
+            }
+            // split: a new node at the first differing byte takes c and the new leaf
+            int d = FirstDiffByte(u, other);
+            RadixN4* top = static_cast<RadixN4*>(NewInner(RADIX_N4, d, u & PrefixMask(d)));
+            PutSorted(top, Byte(other, d), c);
+            PutSorted(top, Byte(u, d), MakeLeaf(key));
+            *ref = reinterpret_cast<RadixChild>(top);
+            break;
+        }
+        size++;
+        return true;
+    }
+
+    bool Erase(Key key) {
+        uint64_t u = Bits(key);
+        RadixChild* parentRef = nullptr;
+        RadixInner* parent = nullptr;
+        RadixChild* ref = &root;
+        while (*ref && !IsLeaf(*ref)) {
+            RadixInner* n = Inner(*ref);
+            comparisons++;
+            RadixChild* next = FindChild(n, Byte(u, n->depth));
+            if (!next) return false;
+            parentRef = ref;
+            parent = n;
+            ref = next;
+        }
+        if (!*ref) return false;
+        comparisons++;
+        if (LeafKey(*ref) != key) return false;
+        FreeLeaf(*ref);
+        if (parent) RemoveChild(*parentRef, parent, Byte(u, parent->depth));
+        else root = 0;
+        size--;
+        return true;
+    }
+
+    // Calls visit(key) for every key in [lo, hi] in order; returns how many.
+    template <typename Visit>
+    size_t RangeScan(Key lo, Key hi, Visit&& visit) {
+        return root ? ScanFrom(root, Bits(lo), Bits(hi), visit) : 0;
+    }
+
+    template <typename Visit>
+    size_t ScanFrom(RadixChild c, uint64_t lo, uint64_t hi, Visit& visit) {
+        if (IsLeaf(c)) {
+            Key k = LeafKey(c);
+            if (Bits(k) < lo || Bits(k) > hi) return 0;
+            visit(k);
+            return 1;
+        }
+        RadixInner* n = Inner(c);
+        int shift = 56 - 8 * n->depth;
+        uint64_t low = shift ? ~0ull >> (64 - shift) : 0; // bits below the branching byte
+        size_t count = 0;
+        ForEachChild(n, [&](unsigned b, RadixChild child) {
+            uint64_t first = n->prefix | ((uint64_t)b << shift);
+            if (first + low >= lo && first <= hi) count += ScanFrom(child, lo, hi, visit);
+        });
+        return count;
+    }
+
+    int Height() const {
+        int height = 0;
+        std::vector<std::pair<RadixChild, int>> stack;
+        if (root) stack.push_back({ root, 1 });
+        while (!stack.empty()) {
+            auto [c, d] = stack.back();
+            stack.pop_back();
+            height = std::max(height, d);
+            if (!IsLeaf(c)) ForEachChild(Inner(c), [&](unsigned, RadixChild child) { stack.push_back({ child, d + 1 }); });
+        }
+        return height;
+    }
+
+    void Clear() {
+        std::vector<RadixChild> stack;
+        if (root) stack.push_back(root);
+        while (!stack.empty()) {
+            RadixChild c = stack.back();
+            stack.pop_back();
+            if (IsLeaf(c)) {
+                FreeLeaf(c);
+                continue;
+            }
+            ForEachChild(Inner(c), [&](unsigned, RadixChild child) { stack.push_back(child); });
+            FreeInner(Inner(c));
+        }
+        root = 0;
+        size = 0;
+    }
+};
+
+// One operation of a workload shared by all engines.
+struct EngineOp {
+    enum Kind : unsigned char { INSERT, ERASE, SEARCH } kind;
+    Key key;
+};
+
+// Node of an engine tree flattened for drawing: x is the in-order rank in [0, 1],
+// y the depth; parent is an index into the same snapshot (-1 for the root).
+// A B+ tree page is a box from x to x + span holding keyCount keys from
+// firstKey on in the snapshot's key list; next links a leaf to the one after it.
+// A skip list node is a tower: x is (rank + 1) / (size + 1), leaving 0 for the
+// head, and y its number of levels. A radix inner node (red = false) branches
+// on byte firstKey with room for keyCount children; branch is the byte value on
+// the edge from its parent, for leaves too.
+struct EngineSnapNode {
+    float x, y;
+    int parent;
+    Key key;
+    bool red;
+    float span = 0.0f;
+    int firstKey = 0, keyCount = 0;
+    int next = -1;
+    int branch = -1;
+};
+
+struct EngineStats {
+    uint64_t ops = 0;
+    uint64_t comparisons = 0;
+    uint64_t rotations = 0;
+    size_t size = 0;
+    int height = 0;
+    double nsPerOp = 0.0;
+    size_t pending = 0;
+};
+
+// An engine plus the thread that applies its workload. The UI posts the same
+// op batch to every worker and only ever reads the published stats/snapshot.
+struct EngineWorker {
+    static const size_t SNAPSHOT_LIMIT = 1023; // larger trees publish counters only
+
+    EngineKind kind;
+    OrderedEngine engine; // the binary kinds
+    BPlusTree pages;      // ENGINE_BPLUS
+    SkipList skip;        // ENGINE_SKIP_LIST
+    RadixTree radix;      // ENGINE_RADIX
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::vector<EngineOp> pending;  // guarded by mtx
+    bool stopping = false;          // guarded by mtx
+    EngineStats stats;              // guarded by mtx
+    std::vector<EngineSnapNode> snapshot; // guarded by mtx
+    std::vector<Key> snapshotKeys;  // guarded by mtx
+    std::vector<SkipStep> searchTrace; // guarded by mtx: last search of a drawable skip list
+    bool searchFound = false;       // guarded by mtx
+    uint64_t searchSerial = 0;      // guarded by mtx: bumped per traced search
+    double busyNs = 0.0;            // worker thread only
+    uint64_t traceSeen = 0;         // UI thread only: serial being animated
+    int traceFrames = 0;            // UI thread only
+    std::thread thread;
+
+    explicit EngineWorker(EngineKind k) : kind(k), engine(k) {
+        thread = std::thread([this] { Run(); });
+    }
+
+    ~EngineWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void Post(const std::vector<EngineOp>& ops) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            pending.insert(pending.end(), ops.begin(), ops.end());
+            stats.pending = pending.size();
+        }
+        wake.notify_one();
+    }
+
+    EngineStats Stats() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return stats;
+    }
+
+    void CopySnapshot(std::vector<EngineSnapNode>& out, std::vector<Key>& keysOut) {
+        std::lock_guard<std::mutex> lock(mtx);
+        out = snapshot;
+        keysOut = snapshotKeys;
+    }
+
+    uint64_t CopySearchTrace(std::vector<SkipStep>& out, bool& found) {
+        std::lock_guard<std::mutex> lock(mtx);
+        out = searchTrace;
+        found = searchFound;
+        return searchSerial;
+    }
+
+    void Apply(const EngineOp& op) {
+        switch (kind) {
+        case ENGINE_BPLUS:
+            if (op.kind == EngineOp::INSERT) pages.Insert(op.key);
+            else if (op.kind == EngineOp::ERASE) pages.Erase(op.key);
+            else pages.Contains(op.key);
+            break;
+        case ENGINE_SKIP_LIST:
+            if (op.kind == EngineOp::INSERT) skip.Insert(op.key);
+            else if (op.kind == EngineOp::ERASE) skip.Erase(op.key);
+            else skip.Contains(op.key);
+            break;
+        case ENGINE_RADIX:
+            if (op.kind == EngineOp::INSERT) radix.Insert(op.key);
+            else if (op.kind == EngineOp::ERASE) radix.Erase(op.key);
+            else radix.Contains(op.key);
+            break;
+        default:
+            if (op.kind == EngineOp::INSERT) engine.Insert(op.key);
+            else if (op.kind == EngineOp::ERASE) engine.Erase(op.key);
+            else engine.Contains(op.key);
+        }
+    }
+
+    size_t Size() const {
+        switch (kind) {
+        case ENGINE_BPLUS: return pages.size;
+        case ENGINE_SKIP_LIST: return skip.size;
+        case ENGINE_RADIX: return radix.size;
+        default: return engine.size;
+        }
+    }
+
+    uint64_t Comparisons() const {
+        switch (kind) {
+        case ENGINE_BPLUS: return pages.comparisons;
+        case ENGINE_SKIP_LIST: return skip.comparisons;
+        case ENGINE_RADIX: return radix.comparisons;
+        default: return engine.comparisons;
+        }
+    }
+
+    uint64_t Restructures() const {
+        switch (kind) {
+        case ENGINE_BPLUS: return pages.restructures;
+        case ENGINE_SKIP_LIST: return skip.relinks;
+        case ENGINE_RADIX: return radix.resizes;
+        default: return engine.rotations;
+        }
+    }
+
+    int Height() const {
+        switch (kind) {
+        case ENGINE_BPLUS: return pages.Height();
+        case ENGINE_SKIP_LIST: return skip.Height();
+        case ENGINE_RADIX: return radix.Height();
+        default: return engine.Height();
+        }
+    }
+
+    void Run() {
+        std::vector<EngineOp> batch;
+        std::vector<EngineSnapNode> snap;
+        std::vector<Key> snapKeys;
+        std::vector<SkipStep> trace;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (stopping) return;
+                batch.swap(pending);
+                pending.clear();
+            }
+            // a skip list records the stops of the batch's last search for the viewport
+            size_t traced = batch.size();
+            if (kind == ENGINE_SKIP_LIST && skip.size <= SNAPSHOT_LIMIT)
+                for (size_t i = 0; i < batch.size(); ++i)
+                    if (batch[i].kind == EngineOp::SEARCH) traced = i;
+            trace.clear();
+            bool found = false;
+            auto t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (i == traced) found = skip.Contains(batch[i].key, &trace);
+                else Apply(batch[i]);
+            }
+            busyNs += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+            snap.clear();
+            snapKeys.clear();
+            if (Size() <= SNAPSHOT_LIMIT) {
+                if (kind == ENGINE_BPLUS) BuildPageSnapshot(snap, snapKeys);
+                else if (kind == ENGINE_SKIP_LIST) BuildTowerSnapshot(snap);
+                else if (kind == ENGINE_RADIX) BuildRadixSnapshot(snap);
+                else BuildSnapshot(snap);
+            }
+
+            std::lock_guard<std::mutex> lock(mtx);
+            stats.ops += batch.size();
+            stats.comparisons = Comparisons();
+            stats.rotations = Restructures();
+            stats.size = Size();
+            stats.height = Height();
+            stats.nsPerOp = stats.ops ? busyNs / (double)stats.ops : 0.0;
+            stats.pending = pending.size();
+            snapshot.swap(snap);
+            snapshotKeys.swap(snapKeys);
+            if (traced < batch.size()) {
+                searchTrace.swap(trace);
+                searchFound = found;
+                searchSerial++;
+            }
+            batch.clear();
+        }
+    }
+
+    void BuildSnapshot(std::vector<EngineSnapNode>& out) const {
+        // in-order walk gives x ranks; parents are resolved through a node->index map
+        std::vector<std::pair<CmpNode*, int>> order; // node, depth
+        std::vector<std::pair<CmpNode*, int>> stack;
+        CmpNode* cur = engine.root;
+        int depth = 0;
+        while (cur || !stack.empty()) {
+            while (cur) { stack.push_back({ cur, depth }); cur = cur->left; depth++; }
+            auto [n, d] = stack.back();
+            stack.pop_back();
+            order.push_back({ n, d });
+            cur = n->right;
+            depth = d + 1;
+        }
+        float denom = order.size() > 1 ? (float)(order.size() - 1) : 1.0f;
+        for (size_t i = 0; i < order.size(); ++i) {
+            CmpNode* n = order[i].first;
+            out.push_back({ order.size() > 1 ? (float)i / denom : 0.5f, (float)order[i].second, -1, n->key, n->red });
+        }
+        std::unordered_map<const CmpNode*, int> index;
+        index.reserve(order.size());
+        for (size_t i = 0; i < order.size(); ++i) index[order[i].first] = (int)i;
+        for (size_t i = 0; i < order.size(); ++i)
+            if (CmpNode* p = order[i].first->parent) out[i].parent = index[p];
+    }
+
+    // Pages in pre-order; each spans the in-order ranks of the keys below it.
+    void BuildPageSnapshot(std::vector<EngineSnapNode>& out, std::vector<Key>& keys) const {
+        float total = (float)std::max<size_t>(pages.size, 1);
+        size_t rank = 0;
+        int lastLeaf = -1;
+        std::function<void(const BPlusPage*, int, int)> visit = [&](const BPlusPage* page, int depth, int parent) {
+            int index = (int)out.size();
+            out.push_back({ rank / total, (float)depth, parent, page->keys.empty() ? 0 : page->keys.front(), page->leaf });
+            out[index].firstKey = (int)keys.size();
+            out[index].keyCount = (int)page->keys.size();
+            keys.insert(keys.end(), page->keys.begin(), page->keys.end());
+            if (page->leaf) {
+                rank += page->keys.size();
+                if (lastLeaf >= 0) out[lastLeaf].next = index;
+                lastLeaf = index;
+            }
+            for (const BPlusPage* child : page->children) visit(child, depth + 1, index);
+            out[index].span = rank / total - out[index].x;
+        };
+        if (pages.root) visit(pages.root, 0, -1);
+    }
+
+    void BuildTowerSnapshot(std::vector<EngineSnapNode>& out) const {
+        float slots = (float)(skip.size + 1);
+        size_t rank = 0;
+        for (const SkipNode* n = skip.head->next[0]; n; n = n->next[0], ++rank)
+            out.push_back({ (float)(rank + 1) / slots, (float)n->levels, -1, n->key, false });
+    }
+
+    // Pre-order; leaves get x from their rank, inner nodes sit over the middle
+    // of their first and last child.
+    void BuildRadixSnapshot(std::vector<EngineSnapNode>& out) const {
+        float total = (float)std::max<size_t>(radix.size, 1);
+        size_t rank = 0;
+        std::function<int(RadixChild, int, int, int)> visit = [&](RadixChild c, int depth, int parent, int branch) {
+            int index = (int)out.size();
+            if (RadixTree::IsLeaf(c)) {
+                out.push_back({ ((float)rank++ + 0.5f) / total, (float)depth, parent, RadixTree::LeafKey(c), true });
+                out[index].branch = branch;
+                return index;
+            }
+            RadixInner* n = RadixTree::Inner(c);
+            out.push_back({ 0.0f, (float)depth, parent, (Key)(n->prefix ^ (1ull << 63)), false });
+            out[index].firstKey = n->depth;
+            out[index].keyCount = RadixTree::Capacity(n->kind);
+            out[index].branch = branch;
+            int first = -1, last = -1;
+            RadixTree::ForEachChild(n, [&](unsigned b, RadixChild child) {
+                last = visit(child, depth + 1, index, (int)b);
+                if (first < 0) first = last;
+            });
+            out[index].x = (out[first].x + out[last].x) / 2;
+            return index;
+        };
+        if (radix.root) visit(radix.root, 0, -1, -1);
+    }
+};
+
+#if !BST_HEADLESS
+// ---------- Globals ----------
+static Node* root = nullptr;
+// Named trees A and B: treap copies kept in the arena beside the drawn tree
+// (compaction relocates them too) as operands for the set operations.
+struct NamedTree {
+    Node* root = nullptr;
+    size_t size = 0;
+    DigestIndex digests; // subtree hashes for the diff (BST_MERKLE: kept in the nodes instead)
+    uint64_t source = 0; // Merkle hash of the drawn tree it was stored from
+};
+static NamedTree namedTrees[2];
+
+// Nodes of the drawn tree alone: the arena also holds the named-tree copies.
+size_t DrawnTreeNodes() {
+    return g_arena.live - namedTrees[0].size - namedTrees[1].size;
+}
+
+// Whole-tree copies and generation check this first: running out of arena
+// slots aborts. `extra` is the net number of nodes the operation adds.
+bool ArenaHasRoom(size_t extra) {
+    return !g_arena.base || g_arena.live + extra < g_arena.capacity;
+}
+
+std::string ArenaFullMessage(size_t extra) {
+    return "Not enough node slots: needs " + std::to_string(extra) + ", "
+        + std::to_string(g_arena.capacity - 1 - g_arena.live) + " free";
+}
+static std::string diffRemovedText; // keys the last diff removed, drawn under the named-tree keys
+static const int SCREEN_W = 1400;
+static const int SCREEN_H = 900;
+
+// Range delete in progress: every node in [lo, hi] shrinks and fades together.
+struct RangeFade {
+    bool active = false;
+    Key lo = 0, hi = 0;
+    float progress = 0.0f;
+};
+static RangeFade rangeFade;
+
+// ---------- Collapsed subtrees ----------
+// A collapsed node is drawn as one summary (count and key range) and nothing
+// below it is laid out, eased or drawn. Nodes at autoCollapseDepth (0 = off)
+// start collapsed; the per-node flag flips that default.
+static int autoCollapseDepth = 0;
+
+bool CollapseWanted(const Node* n, int depth) {
+    return HasCollapseFlag(n) != (autoCollapseDepth > 0 && depth == autoCollapseDepth);
+}
+
+bool IsCollapsed(const Node* n, int depth) {
+    return (n->left || n->right) && CollapseWanted(n, depth);
+}
+
+struct CollapseSummary {
+    size_t count;
+    Key lo, hi;
+};
+
+// ---------- Layout & animation helpers ----------
+void ComputePositions(Node* node, float cx, float cy, float offset, int depth = 0) {
+    if (!node) return;
+    node->x = cx;
+    node->y = cy;
+    // first appearance: start where it belongs
+    if (node->animX == 0 && node->animY == 0) {
+        node->animX = node->x; node->animY = node->y;
+    }
+    if (IsCollapsed(node, depth)) return;
+    if (node->left) ComputePositions(node->left, cx - offset, cy + 90.0f, offset * 0.6f, depth + 1);
+    if (node->right) ComputePositions(node->right, cx + offset, cy + 90.0f, offset * 0.6f, depth + 1);
+}
+
+// Lazy layout: a structural change only bumps layoutGeneration; positions are
+// computed for the subtrees that reach the viewport (and for nodes the state
+// machines touch) and cached on the node until the next change. The layout is
+// geometric (offset shrinks by 0.6 per level), so a subtree whose root sits at
+// cx with offset o spans cx +- 2.5 * o and never needs its size.
+// Needs parent links to position an arbitrary node on demand.
+static bool lazyLayout = BST_PARENT_LINKS;
+static uint32_t layoutGeneration = 1;
+static Rectangle layoutView = { 0, 0, (float)SCREEN_W, (float)SCREEN_H }; // world-space viewport
+
+static void PlaceNode(Node* n, float cx, float cy) {
+    n->x = cx;
+    n->y = cy;
+    if (n->layoutStamp == 0) { n->animX = cx; n->animY = cy; } // first appearance snaps
+    n->layoutStamp = layoutGeneration;
+}
+
+// Positions `n` (and its ancestors) if they are stale; a no-op in full layout.
+void EnsureLaidOut(Node* n) {
+#if BST_PARENT_LINKS
+    if (!lazyLayout || !n || n->layoutStamp == layoutGeneration) return;
+    static std::vector<Node*> chain;
+    chain.clear();
+    for (Node* cur = n; cur; cur = cur->parent) chain.push_back(cur);
+    float cx = SCREEN_W / 2.0f, cy = 80.0f, offset = 220.0f;
+    for (size_t i = chain.size(); i-- > 0;) {
+        Node* cur = chain[i];
+        if (i + 1 < chain.size()) {
+            cx += cur == chain[i + 1]->left ? -offset : offset;
+            cy += 90.0f;
+            offset *= 0.6f;
+        }
+        if (cur->layoutStamp != layoutGeneration) PlaceNode(cur, cx, cy);
+    }
+#else
+    (void)n;
+#endif
+}
+
+// Visible nodes in pre-order (the order DrawTree uses), laying out stale ones
+// on the way. Subtrees whose bounds miss the view, or that are collapsed, are
+// skipped whole.
+struct VisibleNode {
+    Node* node;
+    int depth;
+};
+
+void CollectVisible(Node* r, Rectangle view, std::vector<VisibleNode>& out) {
+    struct Frame { Node* node; float cx, cy, offset; int depth; };
+    static std::vector<Frame> stack;
+    const float margin = 40.0f; // node radius plus highlight ring
+    out.clear();
+    stack.clear();
+    if (r) stack.push_back({ r, SCREEN_W / 2.0f, 80.0f, 220.0f, 0 });
+    while (!stack.empty()) {
+        Frame f = stack.back();
+        stack.pop_back();
+        float reach = 2.5f * f.offset + margin;
+        if (f.cx + reach < view.x || f.cx - reach > view.x + view.width || f.cy - margin > view.y + view.height) continue;
+        Node* n = f.node;
+        if (n->layoutStamp != layoutGeneration) PlaceNode(n, f.cx, f.cy);
+        bool collapsed = IsCollapsed(n, f.depth);
+        if (f.cy + 90.0f + margin >= view.y) out.push_back({ n, f.depth }); // an edge may still reach into view
+        if (collapsed) continue;
+        // children are placed too, so edges leaving the view have an endpoint
+        if (n->left && n->left->layoutStamp != layoutGeneration) PlaceNode(n->left, f.cx - f.offset, f.cy + 90.0f);
+        if (n->right && n->right->layoutStamp != layoutGeneration) PlaceNode(n->right, f.cx + f.offset, f.cy + 90.0f);
+        if (n->right) stack.push_back({ n->right, f.cx + f.offset, f.cy + 90.0f, f.offset * 0.6f, f.depth + 1 });
+        if (n->left) stack.push_back({ n->left, f.cx - f.offset, f.cy + 90.0f, f.offset * 0.6f, f.depth + 1 });
+    }
+}
+
+void RecomputeLayoutAndSnap(Node* r) {
+#if BST_DEBUG_CHECKS
+    assert(CheckParentLinks(r));
+#endif
+    layoutGeneration++; // also invalidates cached collapse summaries without BST_SUBTREE_STATS
+    if (lazyLayout) return;
+    ComputePositions(r, SCREEN_W / 2.0f, 80.0f, 220.0f);
+}
+
+void SmoothMoveAll(Node* node, float easing = 0.18f, int depth = 0) {
+    if (!node) return;
+    node->animX += (node->x - node->animX) * easing;
+    node->animY += (node->y - node->animY) * easing;
+    if (IsCollapsed(node, depth)) return;
+    SmoothMoveAll(node->left, easing, depth + 1);
+    SmoothMoveAll(node->right, easing, depth + 1);
+}
+
+// Eases only the nodes in view; off-screen ones resume when they come back.
+void SmoothMoveVisible(float easing = 0.18f) {
+    static std::vector<VisibleNode> visible;
+    CollectVisible(root, layoutView, visible);
+    for (const VisibleNode& v : visible) {
+        v.node->animX += (v.node->x - v.node->animX) * easing;
+        v.node->animY += (v.node->y - v.node->animY) * easing;
+    }
+}
+
+// Count and key range under a collapsed node. With BST_SUBTREE_STATS the count
+// is kept in the node and only the two spines are walked; otherwise the whole
+// sum is cached until the structure changes.
+CollapseSummary SummaryOf(Node* n) {
+    CollapseSummary sum{ 0, n->value, n->value };
+    for (Node* m = n; m; m = m->left) sum.lo = m->value;
+    for (Node* m = n; m; m = m->right) sum.hi = m->value;
+#if BST_SUBTREE_STATS
+    sum.count = n->subtreeLive;
+    return sum;
+#else
+    static std::unordered_map<const Node*, CollapseSummary> cache;
+    static uint32_t cacheGeneration = 0;
+    if (cacheGeneration != layoutGeneration) {
+        cache.clear();
+        cacheGeneration = layoutGeneration;
+    }
+    auto it = cache.find(n);
+    if (it != cache.end()) return it->second;
+    static std::vector<Node*> stack;
+    stack.assign(1, n);
+    while (!stack.empty()) {
+        Node* m = stack.back();
+        stack.pop_back();
+        if (!IsTombstone(m)) sum.count++;
+        if (m->left) stack.push_back(m->left);
+        if (m->right) stack.push_back(m->right);
+    }
+    return cache.emplace(n, sum).first->second;
+#endif
+}
+
+// Levels in n's subtree: stored with BST_SUBTREE_STATS, walked otherwise.
+int SubtreeHeight(Node* n) {
+#if BST_SUBTREE_STATS
+    return n ? (int)n->subtreeHeight : 0;
+#else
+    return TreeHeight(n);
+#endif
+}
+
+// ---------- Quality governor ----------
+// Holds the frame budget on slow machines by degrading in steps when measured
+// frame work runs over budget, and restoring one step at a time once there is
+// clear headroom again (fast down, slow up, so it does not oscillate).
+enum QualityLevel {
+    QUALITY_FULL,
+    QUALITY_NO_LABELS,          // no key labels or summary text
+    QUALITY_NO_RINGS,           // no traversal rings or node outlines
+    QUALITY_LOD,                // nodes under a few pixels, or packed closer than that, become dots without edges
+    QUALITY_HALF_RATE_ANIMATION,// easing runs every other simulation step
+    QUALITY_LEVEL_COUNT
+};
+
+const char* QualityLevelName(QualityLevel level) {
+    switch (level) {
+    case QUALITY_NO_LABELS: return "no labels";
+    case QUALITY_NO_RINGS: return "no rings";
+    case QUALITY_LOD: return "LOD";
+    case QUALITY_HALF_RATE_ANIMATION: return "half-rate animation";
+    default: return "full";
+    }
+}
+
+static const float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+static const float LOD_MIN_RADIUS_PX = 6.0f;
+
+struct QualityGovernor {
+    bool automatic = true;
+    QualityLevel level = QUALITY_FULL;
+    QualityLevel maxLevel = QUALITY_HALF_RATE_ANIMATION;
+    float smoothedMs = 0.0f;
+    int overFrames = 0;
+    int underFrames = 0;
+    int settleFrames = 0; // after a change, let the average catch up before judging again
+
+    void Update(float frameMs) {
+        smoothedMs += (frameMs - smoothedMs) * 0.1f;
+        if (!automatic) return;
+        if (settleFrames > 0) {
+            settleFrames--;
+            return;
+        }
+        overFrames = smoothedMs > FRAME_BUDGET_MS * 0.9f ? overFrames + 1 : 0;
+        underFrames = smoothedMs < FRAME_BUDGET_MS * 0.5f ? underFrames + 1 : 0;
+        if (overFrames >= 10 && level < maxLevel) {
+            level = (QualityLevel)(level + 1);
+            overFrames = 0;
+            settleFrames = 30;
+        }
+        else if (underFrames >= 120 && level > QUALITY_FULL) {
+            level = (QualityLevel)(level - 1);
+            underFrames = 0;
+            settleFrames = 30;
+        }
+    }
+};
+static QualityGovernor quality;
+static float drawZoom = 1.0f; // camera zoom of the frame being drawn (LOD)
+static int lodDepth = 64;     // LodDepth(drawZoom)
+
+// First depth whose sibling slots sit under 2 * LOD_MIN_RADIUS_PX apart on
+// screen. Circles there merge into one band at any zoom, so LOD draws them as
+// dots as well. Siblings at depth d are 2 * 220 * 0.6^(d-1) apart.
+int LodDepth(float zoom) {
+    int depth = 1;
+    for (float gap = 440.0f * zoom; gap >= 2.0f * LOD_MIN_RADIUS_PX && depth < 64; gap *= 0.6f) depth++;
+    return depth;
+}
+
+// ---------- Selection ----------
+// A clicked node: the panel shows its subtree and S / X search for or delete its
+// key without typing it. Held as the node plus its key; after a structural change
+// the key is looked up again, and the selection is dropped once the key is gone.
+struct Selection {
+    bool active = false;
+    Key key = 0;
+    Node* node = nullptr;
+    uint32_t generation = 0; // layoutGeneration the node pointer and stats belong to
+    int depth = 0;
+    size_t live = 0;         // non-tombstoned nodes in the subtree
+    int height = 0;
+    Key lo = 0, hi = 0;
+};
+static Selection selection;
+
+void SelectNode(Node* n, int depth) {
+    if (!n || IsTombstone(n)) {
+        selection.active = false;
+        selection.node = nullptr;
+        return;
+    }
+    CollapseSummary sum = SummaryOf(n);
+    selection = { true, n->value, n, layoutGeneration, depth, sum.count, SubtreeHeight(n), sum.lo, sum.hi };
+}
+
+// The selected node, re-resolved if the tree changed since it was picked.
+Node* SelectedNode() {
+    if (!selection.active) return nullptr;
+    if (selection.generation != layoutGeneration || IsTombstone(selection.node)) {
+        static PathBuffer path;
+        RecordPath(root, selection.key, path, true);
+        SelectNode(path.found, path.size() - 1);
+    }
+    return selection.node;
+}
+
+// ---------- Drawing ----------
+void DrawNode(Node* node, int depth, Node* highlight, Node* special) {
+    bool collapsed = IsCollapsed(node, depth);
+    if (quality.level >= QUALITY_LOD && (depth >= lodDepth || node->radius * drawZoom < LOD_MIN_RADIUS_PX)) {
+        float side = std::max(2.0f / drawZoom, std::min(node->radius, LOD_MIN_RADIUS_PX / drawZoom));
+        DrawRectangle((int)(node->animX - side / 2), (int)(node->animY - side / 2), (int)std::ceil(side), (int)std::ceil(side),
+            IsTombstone(node) ? Fade(node->color, 0.3f) : node->color);
+        return;
+    }
+    bool labels = quality.level < QUALITY_NO_LABELS;
+    if (collapsed) {
+        // summary: a fan below the node with the hidden subtree's size and key range
+        Vector2 top = { node->animX, node->animY + node->radius - 4 };
+        DrawTriangle(top, { node->animX - 34, node->animY + 70 }, { node->animX + 34, node->animY + 70 }, Fade(GRAY, 0.35f));
+        if (labels) {
+            CollapseSummary sum = SummaryOf(node);
+            std::string count = std::to_string(sum.count) + (sum.count == 1 ? " node" : " nodes");
+            std::string range = "[" + std::to_string(sum.lo) + ".." + std::to_string(sum.hi) + "]";
+            DrawText(count.c_str(), (int)node->animX - MeasureText(count.c_str(), 14) / 2, (int)node->animY + 40, 14, DARKGRAY);
+            DrawText(range.c_str(), (int)node->animX - MeasureText(range.c_str(), 12) / 2, (int)node->animY + 72, 12, DARKGRAY);
+        }
+    }
+    if (node->left && !collapsed) DrawLineV({ node->animX, node->animY }, { node->left->animX, node->left->animY }, BLACK);
+    if (node->right && !collapsed) DrawLineV({ node->animX, node->animY }, { node->right->animX, node->right->animY }, BLACK);
+
+    // Outer highlight ring (single)
+    if (node == highlight) {
+        DrawCircle((int)node->animX, (int)node->animY, node->radius + 6, YELLOW);
+    }
+    if (node == special) {
+        DrawCircle((int)node->animX, (int)node->animY, node->radius + 6, ORANGE);
+    }
+    if (node == selection.node) {
+        DrawCircle((int)node->animX, (int)node->animY, node->radius + 6, VIOLET);
+    }
+
+    // tombstoned nodes stay in place but drawn faded
+    float alpha = IsTombstone(node) ? 0.3f : 1.0f;
+    float radius = node->radius;
+    Color fill = node->color;
+    if (rangeFade.active && node->value >= rangeFade.lo && node->value <= rangeFade.hi) {
+        radius *= 1.0f - rangeFade.progress;
+        alpha *= 1.0f - rangeFade.progress;
+        fill = RED;
+    }
+    DrawCircle((int)node->animX, (int)node->animY, radius, Fade(fill, alpha));
+    if (quality.level < QUALITY_NO_RINGS) DrawCircleLines((int)node->animX, (int)node->animY, radius, Fade(DARKBLUE, alpha));
+    if (labels) DrawText(std::to_string(node->value).c_str(), (int)(node->animX - 10), (int)(node->animY - 10), 20, Fade(BLACK, alpha));
+}
+
+void DrawTree(Node* node, Node* highlight = nullptr, Node* special = nullptr, int depth = 0) {
+    if (!node) return;
+    if (lazyLayout) {
+        static std::vector<VisibleNode> visible;
+        CollectVisible(node, layoutView, visible);
+        for (const VisibleNode& v : visible) DrawNode(v.node, v.depth, highlight, special);
+        return;
+    }
+    DrawNode(node, depth, highlight, special);
+    if (IsCollapsed(node, depth)) return;
+    DrawTree(node->left, highlight, special, depth + 1);
+    DrawTree(node->right, highlight, special, depth + 1);
+}
+
+// ---------- Node picking ----------
+// Clicks are resolved from layout slots, not drawn positions: levels sit 90 apart,
+// further than a node reaches, so the click's row is known up front, and slots
+// come from the layout recurrence itself, so lazy layout needs no positions.
+// With BST_SUBTREE_STATS a pick descends from the root, nearest child first,
+// and skips every subtree that is too short to reach the row or whose slots on
+// it (within ±2.5x its offset) are all further than the best match so far. Edits
+// then cost the pick nothing. Without the stored heights deep rows would defeat
+// that pruning, so it falls back to an index with one row per depth, each sorted
+// by x, rebuilt by the first pick after the structure or a collapse flag changes.
+struct NodePick {
+    Node* node = nullptr;
+    float cx = 0, cy = 0, offset = 0;
+    int depth = 0;
+};
+
+#if BST_SUBTREE_STATS
+inline void MarkPickIndexStale() {}
+
+// Node whose drawn circle contains `world` (the one centred nearest where
+// circles overlap), with the layout frame it sits in.
+NodePick PickNode(Node* r, Vector2 world) {
+    struct Frame { Node* node; float cx, offset; int depth; };
+    static std::vector<Frame> stack;
+    int row = (int)std::lround((world.y - 80.0f) / 90.0f);
+    if (row < 0 || !r || (int)r->subtreeHeight <= row) return {};
+    NodePick best;
+    float bestDx = std::numeric_limits<float>::max();
+    stack.assign(1, { r, SCREEN_W / 2.0f, 220.0f, 0 });
+    while (!stack.empty()) {
+        Frame f = stack.back();
+        stack.pop_back();
+        float dx = std::fabs(world.x - f.cx);
+        if (f.depth == row) {
+            if (dx < bestDx) {
+                bestDx = dx;
+                best = { f.node, f.cx, 0.0f, f.offset, row };
+            }
+            continue;
+        }
+        Node* n = f.node;
+        if (IsCollapsed(n, f.depth)) continue;
+        if (dx - 2.5f * f.offset * (1.0f - std::pow(0.6f, (float)(row - f.depth))) > bestDx) continue;
+        int levelsNeeded = row - f.depth;
+        Frame l{ n->left, f.cx - f.offset, f.offset * 0.6f, f.depth + 1 };
+        Frame g{ n->right, f.cx + f.offset, f.offset * 0.6f, f.depth + 1 };
+        if (l.node && (int)l.node->subtreeHeight < levelsNeeded) l.node = nullptr;
+        if (g.node && (int)g.node->subtreeHeight < levelsNeeded) g.node = nullptr;
+        if (world.x >= f.cx) std::swap(l, g); // near side popped first
+        if (g.node) stack.push_back(g);
+        if (l.node) stack.push_back(l);
+    }
+    if (!best.node) return {};
+    best.cy = 80.0f + 90.0f * row;
+    float dx = world.x - best.cx, dy = world.y - best.cy, radius = best.node->radius;
+    if (dx * dx + dy * dy > radius * radius) return {};
+    return best;
+}
+#else
+struct PickEntry {
+    Node* node;
+    float cx, offset;
+};
+
+struct PickIndex {
+    uint32_t generation = 0; // layoutGeneration it was built for
+    bool stale = true;       // collapse flags changed since
+    std::vector<uint32_t> rowStart; // depth -> first entry; one extra at the end
+    std::vector<PickEntry> entries;
+};
+static PickIndex pickIndex;
+
+inline void MarkPickIndexStale() { pickIndex.stale = true; }
+void BuildPickIndex(Node* r) {
+    struct Frame { Node* node; float cx, offset; int depth; };
+    static std::vector<Frame> stack, slots;
+    stack.clear();
+    slots.clear();
+    int rows = 0;
+    if (r) stack.push_back({ r, SCREEN_W / 2.0f, 220.0f, 0 });
+    while (!stack.empty()) {
+        Frame f = stack.back();
+        stack.pop_back();
+        slots.push_back(f);
+        rows = std::max(rows, f.depth + 1);
+        Node* n = f.node;
+        if (IsCollapsed(n, f.depth)) continue;
+        if (n->right) stack.push_back({ n->right, f.cx + f.offset, f.offset * 0.6f, f.depth + 1 });
+        if (n->left) stack.push_back({ n->left, f.cx - f.offset, f.offset * 0.6f, f.depth + 1 });
+    }
+    PickIndex& idx = pickIndex;
+    idx.rowStart.assign((size_t)rows + 1, 0);
+    for (const Frame& f : slots) idx.rowStart[f.depth + 1]++;
+    for (int d = 0; d < rows; ++d) idx.rowStart[d + 1] += idx.rowStart[d];
+    idx.entries.resize(slots.size());
+    static std::vector<uint32_t> fill;
+    fill.assign(idx.rowStart.begin(), idx.rowStart.end() - 1);
+    for (const Frame& f : slots) idx.entries[fill[f.depth]++] = { f.node, f.cx, f.offset };
+    for (int d = 0; d < rows; ++d) {
+        std::sort(idx.entries.begin() + idx.rowStart[d], idx.entries.begin() + idx.rowStart[d + 1],
+            [](const PickEntry& a, const PickEntry& b) { return a.cx < b.cx; });
+    }
+    idx.generation = layoutGeneration;
+    idx.stale = false;
+}
+
+// Node whose drawn circle contains `world` (the one centred nearest where
+// circles overlap), with the layout frame it sits in.
+NodePick PickNode(Node* r, Vector2 world) {
+    PickIndex& idx = pickIndex;
+    if (idx.stale || idx.generation != layoutGeneration) BuildPickIndex(r);
+    int row = (int)std::lround((world.y - 80.0f) / 90.0f);
+    if (row < 0 || row + 1 >= (int)idx.rowStart.size()) return {};
+    float cy = 80.0f + 90.0f * row;
+    auto first = idx.entries.begin() + idx.rowStart[row], last = idx.entries.begin() + idx.rowStart[row + 1];
+    auto it = std::lower_bound(first, last, world.x, [](const PickEntry& e, float x) { return e.cx < x; });
+    const PickEntry* best = nullptr;
+    if (it != last) best = &*it;
+    if (it != first && (!best || world.x - std::prev(it)->cx < best->cx - world.x)) best = &*std::prev(it);
+    if (!best) return {};
+    float dx = world.x - best->cx, dy = world.y - cy, radius = best->node->radius;
+    if (dx * dx + dy * dy > radius * radius) return {};
+    return { best->node, best->cx, cy, best->offset, row };
+}
+#endif
+
+// Collapse or expand one node. Positions do not depend on collapsing, so only
+// the revealed subtree needs a layout (lazy layout does that when it is drawn).
+void ToggleCollapse(const NodePick& pick) {
+    Node* n = pick.node;
+    SetCollapseFlag(n, !HasCollapseFlag(n));
+    MarkPickIndexStale();
+    if (lazyLayout || IsCollapsed(n, pick.depth)) return;
+    ComputePositions(n, pick.cx, pick.cy, pick.offset, pick.depth);
+    // revealed nodes unfold from the summary node
+    static std::vector<std::pair<Node*, int>> stack;
+    stack.clear();
+    if (n->left) stack.push_back({ n->left, pick.depth + 1 });
+    if (n->right) stack.push_back({ n->right, pick.depth + 1 });
+    while (!stack.empty()) {
+        auto [m, d] = stack.back();
+        stack.pop_back();
+        m->animX = n->animX;
+        m->animY = n->animY;
+        if (IsCollapsed(m, d)) continue;
+        if (m->left) stack.push_back({ m->left, d + 1 });
+        if (m->right) stack.push_back({ m->right, d + 1 });
+    }
+}
+
+// Operations expand what they walk through, so the path stays visible.
+void ExpandAlong(const PathBuffer& path) {
+    bool changed = false;
+    for (int i = 0; i < path.size(); ++i) {
+        if (CollapseWanted(path[i], i)) {
+            SetCollapseFlag(path[i], !HasCollapseFlag(path[i]));
+            changed = true;
+        }
+    }
+    if (changed) MarkPickIndexStale();
+    if (changed && !lazyLayout) RecomputeLayoutAndSnap(root);
+}
+
+// Layout slot a new child of the path's attach point will occupy
+// (mirrors ComputePositions: the offset shrinks by 0.6 per level).
+Vector2 AttachPosition(const PathBuffer& path) {
+    if (!path.parent) return { SCREEN_W / 2.0f, 80.0f };
+    EnsureLaidOut(path.parent);
+    float offset = 220.0f * std::pow(0.6f, (float)(path.size() - 1));
+    float x = path.attachLeft ? path.parent->x - offset : path.parent->x + offset;
+    return { x, path.parent->y + 90.0f };
+}
+
+// ---------- Tweens ----------
+// Scripted animations (moves, shrinks, fades) run as tweens on float fields:
+// a fixed pool evaluated in one pass per simulation step, with easing curves
+// sampled into tables once at startup, so nothing allocates or calls sin/pow
+// per frame. Layout following stays the exponential chase in SmoothMoveAll,
+// whose targets change under every relayout and may cover the whole tree.
+enum EaseCurve { EASE_LINEAR, EASE_CUBIC_IN_OUT, EASE_BACK_OUT, EASE_ELASTIC_OUT, EASE_CURVE_COUNT };
+
+static const int EASE_TABLE_STEPS = 256;
+
+struct EaseTables {
+    float values[EASE_CURVE_COUNT][EASE_TABLE_STEPS + 1];
+
+    EaseTables() {
+        const float pi = 3.14159265f;
+        for (int i = 0; i <= EASE_TABLE_STEPS; ++i) {
+            float t = (float)i / EASE_TABLE_STEPS, u = t - 1.0f;
+            values[EASE_LINEAR][i] = t;
+            values[EASE_CUBIC_IN_OUT][i] = t < 0.5f ? 4.0f * t * t * t : 1.0f + 4.0f * u * u * u;
+            values[EASE_BACK_OUT][i] = 1.0f + 2.70158f * u * u * u + 1.70158f * u * u;
+            values[EASE_ELASTIC_OUT][i] = (i == 0 || i == EASE_TABLE_STEPS) ? t
+                : std::pow(2.0f, -10.0f * t) * std::sin((10.0f * t - 0.75f) * (2.0f * pi / 3.0f)) + 1.0f;
+        }
+    }
+};
+static const EaseTables easeTables;
+
+float Ease(EaseCurve curve, float t) {
+    float f = std::clamp(t, 0.0f, 1.0f) * EASE_TABLE_STEPS;
+    int i = std::min((int)f, EASE_TABLE_STEPS - 1);
+    const float* v = easeTables.values[curve];
+    return v[i] + (v[i + 1] - v[i]) * (f - (float)i);
+}
+
+struct Tween {
+    float* target;
+    float from, to;
+    float t, dt; // progress 0..1 and its increment per step
+    EaseCurve curve;
+};
+
+static const int TWEEN_POOL_SIZE = 64;
+static Tween tweens[TWEEN_POOL_SIZE];
+static int tweenCount = 0;
+
+// Animates *target to `to` over `frames` steps, replacing any tween already on
+// it. The target must outlive the tween. A full pool jumps straight to the end.
+void StartTween(float* target, float to, float frames, EaseCurve curve) {
+    int i = 0;
+    while (i < tweenCount && tweens[i].target != target) ++i;
+    if (frames <= 0.0f || (i == tweenCount && tweenCount == TWEEN_POOL_SIZE)) {
+        if (i < tweenCount) tweens[i] = tweens[--tweenCount]; // drop the old tween: swap in the last one
+        *target = to;
+        return;
+    }
+    if (i == tweenCount) tweenCount++;
+    tweens[i] = { target, *target, to, 0.0f, 1.0f / frames, curve };
+}
+
+bool Tweening(const float* target) {
+    for (int i = 0; i < tweenCount; ++i)
+        if (tweens[i].target == target) return true;
+    return false;
+}
+
+// Jumps every tween to its end value (before changes that may free its target).
+void FinishTweens() {
+    for (int i = 0; i < tweenCount; ++i) *tweens[i].target = tweens[i].to;
+    tweenCount = 0;
+}
+
+void UpdateTweens() {
+    for (int i = 0; i < tweenCount;) {
+        Tween& tw = tweens[i];
+        tw.t = std::min(tw.t + tw.dt, 1.0f);
+        *tw.target = tw.from + (tw.to - tw.from) * Ease(tw.curve, tw.t);
+        if (tw.t >= 1.0f) tw = tweens[--tweenCount]; // finished: swap in the last one
+        else ++i;
+    }
+}
+
+// ---------- New node highlight ----------
+// Newly inserted nodes stay red for NEW_NODE_RED_FRAMES, each on its own timer,
+// then turn SKYBLUE. Entries hold the key rather than the node: a delete or an
+// arena compaction may free or move the node before its timer runs out.
+struct PendingColor {
+    Key key;
+    int framesLeft;
+};
+static std::vector<PendingColor> pendingColors;
+static const int NEW_NODE_RED_FRAMES = 120; // 2 seconds
+
+// ---------- Insert immediate helper (fallback) ----------
+void InsertValueImmediate(Node*& rootRef, Key value) {
+    static PathBuffer path;
+    RecordPath(rootRef, value, path, false);
+    Vector2 pos = AttachPosition(path);
+    Node* n = NewNode(value, pos.x, pos.y);
+    n->color = RED;
+    pendingColors.push_back({ value, NEW_NODE_RED_FRAMES });
+    LinkAtPath(rootRef, path, n);
+    RecomputeLayoutAndSnap(rootRef);
+}
+
+// ---------- State machines: Insert, Delete, Search ----------
+
+// Insert state
+enum InsertStage { INS_IDLE, INS_TRAVERSING, INS_ATTACHING };
+static InsertStage insStage = INS_IDLE;
+static PathBuffer insTraversalPath;
+static int insTraversalIndex = 0;
+static int insFramesCounter = 0;
+static const int INS_STEP_FRAMES = 12;
+static Node* insNewNode = nullptr;
+static float insNewX = 0, insNewY = 0;
+static Key insValuePending = 0;
+
+// Delete state
+enum DelStage {
+    DEL_IDLE, DEL_TRAVERSING, DEL_HIGHLIGHT_TARGET, DEL_HIGHLIGHT_SUCCESSOR,
+    DEL_MOVE_SUCCESSOR, DEL_MOVE_CHILD_UP, DEL_SHRINK_REMOVE, DEL_RANGE_FADE, DEL_FINALIZE
+};
+static DelStage delStage = DEL_IDLE;
+static PathBuffer delTraversalPath;
+static int delTraversalIndex = 0;
+static int delFramesCounter = 0;
+static const int DEL_STEP_FRAMES = 12;
+static Node* delTargetParent = nullptr;
+static Node* delTargetNode = nullptr;
+static Node* successorParent = nullptr;
+static Node* successorNode = nullptr;
+static bool delReplaceFromLeft = false; // two-children delete uses the predecessor
+static Node* animNode = nullptr;
+static Node* animReplaceNode = nullptr;
+static float animDuration = 24.0f; // frames per delete move / shrink
+static float animAlpha = 1.0f;     // fade of the node shrinking out
+static Key delValuePending = 0; // <-- pending delete value entered by user
+static bool delLazy = false;      // tombstone mode: mark instead of relinking
+static size_t tombstoneCount = 0;
+
+// Search state
+enum SearchStage { S_IDLE, S_TRAVERSING, S_FLASH_FOUND, S_FLASH_NOTFOUND };
+static SearchStage searchStage = S_IDLE;
+static PathBuffer searchPath;
+static int searchIndex = 0;
+static int searchFrames = 0;
+static const int SEARCH_STEP_FRAMES = 12;
+static int flashCount = 0;
+static const int FLASH_FRAMES = 12; // frames per flash on/off
+static Node* searchFinalNode = nullptr;
+static Key searchValuePending = 0; // <-- pending search value entered by user
+
+// Arena compaction after deletes (see CompactArena)
+static const float COMPACT_HOLE_THRESHOLD = 0.25f;
+
+// --- Status message (validations) ---
+static std::string statusMessage = "";
+static int statusTimer = 0; // frames: show message for 120 frames (2 sec)
+
+// ---------- Undo / redo ----------
+// Every applied insert and delete is logged with what it takes to invert it
+// exactly. A node's position is kept as left/right steps from the root: entries
+// are undone newest first, so the tree is back in the state right after the
+// operation and the steps still lead to the same slot. A two-children delete
+// also records the key that moved up and how far below the target it sat.
+// Undo and redo each walk one path, O(height). The log drops its oldest entries
+// past undoBudgetBytes (--undo-kb); operations that rebuild the tree (generate,
+// range delete, tombstone purge) clear it.
+enum UndoKind : unsigned char {
+    UNDO_INSERT,           // steps lead to the new leaf
+    UNDO_SPLICE,           // zero/one-child delete: the child (if any) took the node's slot
+    UNDO_COPY_SUCCESSOR,   // two-children delete that pulled up the successor
+    UNDO_COPY_PREDECESSOR, // ... the predecessor
+    UNDO_TOMBSTONE         // lazy delete: only the mark
+};
+
+struct UndoEntry {
+    UndoKind kind = UNDO_INSERT;
+    bool childRight = false;           // UNDO_SPLICE: side the promoted child hung from
+    bool replacementTombstone = false; // copy cases: mark carried up with the key
+    uint32_t group = 0;                // a batch undoes and redoes as one
+    uint32_t replacementDepth = 0;     // copy cases: levels between target and replacement
+    Key key = 0;                       // inserted or deleted key
+    Key replacementKey = 0;            // copy cases: key that moved into the target
+    std::vector<uint8_t> steps;        // root -> node, 0 = left, 1 = right
+
+    size_t Bytes() const { return sizeof(UndoEntry) + steps.capacity(); }
+};
+
+static std::deque<UndoEntry> undoLog;
+static size_t undoCursor = 0;       // entries before it can be undone, from it on redone
+static size_t undoBytes = 0;
+static size_t undoBudgetBytes = 1 << 20;
+static uint32_t undoGroupCounter = 0;
+static bool undoAnimation = true;   // revived nodes grow back in
+
+uint32_t NextUndoGroup() { return ++undoGroupCounter; }
+
+void ClearUndoLog() {
+    undoLog.clear();
+    undoCursor = 0;
+    undoBytes = 0;
+}
+
+static void PushUndo(UndoEntry&& entry) {
+    while (undoLog.size() > undoCursor) { // a new operation forgets what was undone
+        undoBytes -= undoLog.back().Bytes();
+        undoLog.pop_back();
+    }
+    undoBytes += entry.Bytes();
+    undoLog.push_back(std::move(entry));
+    undoCursor++;
+    while (undoBytes > undoBudgetBytes && undoLog.size() > 1) {
+        undoBytes -= undoLog.front().Bytes();
+        undoLog.pop_front();
+        undoCursor--;
+    }
+}
+
+static void StepsOf(const PathBuffer& path, std::vector<uint8_t>& steps) {
+    steps.clear();
+    for (int i = 1; i < path.size(); ++i) steps.push_back(path[i] == path[i - 1]->right ? 1 : 0);
+}
+
+// Log an insert whose node was linked at the attach point of `path`.
+void LogInsert(const PathBuffer& path, Key key, uint32_t group) {
+    UndoEntry e;
+    e.kind = UNDO_INSERT;
+    e.group = group;
+    e.key = key;
+    StepsOf(path, e.steps);
+    if (path.parent) e.steps.push_back(path.attachLeft ? 0 : 1);
+    PushUndo(std::move(e));
+}
+
+// Log a delete of path.found before it is applied. `replacement` is the
+// successor / predecessor a two-children delete copies up (fromLeft: predecessor).
+void LogRemoval(const PathBuffer& path, Node* replacement, bool fromLeft, uint32_t group) {
+    Node* target = path.found;
+    UndoEntry e;
+    e.kind = UNDO_SPLICE;
+    e.group = group;
+    e.key = target->value;
+    StepsOf(path, e.steps);
+    if (replacement) {
+        e.kind = fromLeft ? UNDO_COPY_PREDECESSOR : UNDO_COPY_SUCCESSOR;
+        e.replacementKey = replacement->value;
+        e.replacementTombstone = IsTombstone(replacement);
+        e.replacementDepth = 1;
+        for (Node* cur = fromLeft ? target->left : target->right; cur != replacement; cur = fromLeft ? cur->right : cur->left)
+            e.replacementDepth++;
+    }
+    else e.childRight = target->right != nullptr;
+    PushUndo(std::move(e));
+}
+
+void LogTombstone(const PathBuffer& path, uint32_t group) {
+    UndoEntry e;
+    e.kind = UNDO_TOMBSTONE;
+    e.group = group;
+    e.key = path.found->value;
+    StepsOf(path, e.steps);
+    PushUndo(std::move(e));
+}
+
+// DeleteKey with the removal logged (same replacement choice).
+bool DeleteKeyLogged(Key value, PathBuffer& path, uint32_t group) {
+    RecordPath(root, value, path, true);
+    Node* target = path.found;
+    if (!target) return false;
+    if (target->left && target->right) {
+        bool fromLeft = !ReplaceFromSuccessor(target);
+        auto pr = fromLeft ? FindInorderPredecessor(target) : FindInorderSuccessor(target);
+        LogRemoval(path, pr.second, fromLeft, group);
+        if (fromLeft) RemoveByPredecessorCopy(root, target, pr.first, pr.second);
+        else RemoveBySuccessorCopy(root, target, pr.first, pr.second);
+    }
+    else {
+        LogRemoval(path, nullptr, false, group);
+        SpliceOut(root, path.parent, target);
+    }
+    return true;
+}
+
+static Node* NodeAt(const std::vector<uint8_t>& steps, size_t count) {
+    Node* n = root;
+    for (size_t i = 0; i < count && n; ++i) n = steps[i] ? n->right : n->left;
+    return n;
+}
+
+static Node* SlotChild(Node* parent, bool right) {
+    return !parent ? root : (right ? parent->right : parent->left);
+}
+
+static void SetSlot(Node* parent, bool right, Node* child) {
+    if (parent) {
+        if (right) SetRight(parent, child);
+        else SetLeft(parent, child);
+    }
+    else {
+        root = child;
+#if BST_PARENT_LINKS
+        if (child) child->parent = nullptr;
+#endif
+    }
+    RefreshUp(child ? child : parent);
+}
+
+// A node put back by undo/redo; it springs in from its parent's position.
+static Node* ReviveNode(Key key, Node* parent) {
+    Node* n = parent ? NewNode(key, parent->animX, parent->animY) : NewNode(key, SCREEN_W / 2.0f, 80.0f);
+    if (undoAnimation) {
+        n->radius = 0.0f;
+        StartTween(&n->radius, 25.0f, 30.0f, EASE_ELASTIC_OUT);
+    }
+    return n;
+}
+
+// Put back what the entry's operation removed (undo of a delete) or remove what
+// it added (undo of an insert); `forward` re-applies the operation instead.
+void ApplyUndoEntry(const UndoEntry& e, bool forward) {
+    size_t depth = e.steps.size();
+    bool right = depth && e.steps.back();
+    switch (e.kind) {
+    case UNDO_INSERT: {
+        Node* parent = depth ? NodeAt(e.steps, depth - 1) : nullptr;
+        if (forward) SetSlot(parent, right, ReviveNode(e.key, parent));
+        else SpliceOut(root, parent, SlotChild(parent, right));
+        break;
+    }
+    case UNDO_SPLICE: {
+        Node* parent = depth ? NodeAt(e.steps, depth - 1) : nullptr;
+        if (forward) {
+            SpliceOut(root, parent, SlotChild(parent, right));
+            break;
+        }
+        Node* child = SlotChild(parent, right);
+        Node* n = ReviveNode(e.key, parent);
+        if (e.childRight) SetRight(n, child);
+        else SetLeft(n, child);
+        SetSlot(parent, right, n);
+        break;
+    }
+    case UNDO_COPY_SUCCESSOR:
+    case UNDO_COPY_PREDECESSOR: {
+        bool fromLeft = e.kind == UNDO_COPY_PREDECESSOR;
+        Node* target = NodeAt(e.steps, depth);
+        if (forward) {
+            auto pr = fromLeft ? FindInorderPredecessor(target) : FindInorderSuccessor(target);
+            if (fromLeft) RemoveByPredecessorCopy(root, target, pr.first, pr.second);
+            else RemoveBySuccessorCopy(root, target, pr.first, pr.second);
+            break;
+        }
+        // the replacement sat one step toward its side, then all the way back
+        Node* parent = target;
+        bool slotRight = !fromLeft;
+        for (uint32_t i = 1; i < e.replacementDepth; ++i) {
+            parent = SlotChild(parent, slotRight);
+            slotRight = fromLeft;
+        }
+        Node* child = SlotChild(parent, slotRight);
+        Node* n = ReviveNode(e.replacementKey, parent);
+        SetTombstone(n, e.replacementTombstone);
+        if (fromLeft) SetLeft(n, child);
+        else SetRight(n, child);
+        SetSlot(parent, slotRight, n);
+        target->value = e.key;
+        SetTombstone(target, false);
+        RefreshUp(target);
+        break;
+    }
+    case UNDO_TOMBSTONE: {
+        Node* n = NodeAt(e.steps, depth);
+        SetTombstone(n, forward);
+        RefreshUp(n);
+        if (forward) tombstoneCount++;
+        else tombstoneCount--;
+        break;
+    }
+    }
+}
+
+// Ctrl+Z / Ctrl+Y: one logged operation (a whole batch) back or forward.
+// Returns the number of entries applied.
+size_t UndoStep(bool redo) {
+    if (redo ? undoCursor == undoLog.size() : undoCursor == 0) return 0;
+    size_t first = undoCursor, last = undoCursor; // the group's entries: [first, last)
+    if (redo) {
+        while (last < undoLog.size() && undoLog[last].group == undoLog[undoCursor].group) last++;
+    }
+    else {
+        while (first > 0 && undoLog[first - 1].group == undoLog[undoCursor - 1].group) first--;
+    }
+    size_t applied = last - first;
+    if (g_arena.base && g_arena.live + applied >= g_arena.capacity) return 0; // each entry may revive a node
+    FinishTweens(); // revived nodes may still be growing, and this may free them
+    if (redo) {
+        for (; undoCursor < last; ++undoCursor) ApplyUndoEntry(undoLog[undoCursor], true);
+    }
+    else {
+        while (undoCursor > first) ApplyUndoEntry(undoLog[--undoCursor], false);
+    }
+    insTraversalPath.clear();
+    RecomputeLayoutAndSnap(root);
+    return applied;
+}
+
+// ---------- Start insertion traversal (non-blocking) ----------
+void StartInsertion(Key value) {
+    insTraversalIndex = 0;
+    insFramesCounter = 0;
+    insStage = INS_TRAVERSING;
+    insNewNode = nullptr;
+    insValuePending = value;
+
+    // if root null -> path stays empty and the new node becomes the root
+    RecordPath(root, value, insTraversalPath, false);
+    ExpandAlong(insTraversalPath);
+    Vector2 pos = AttachPosition(insTraversalPath);
+    insNewX = pos.x; insNewY = pos.y;
+}
+
+// Attach new node (called when traversal finished)
+void AttachNewNodeFromPending() {
+    Node* n = NewNode(insValuePending, insNewX, insNewY);
+    n->color = RED;
+    pendingColors.push_back({ insValuePending, NEW_NODE_RED_FRAMES });
+    LinkAtPath(root, insTraversalPath, n);
+    LogInsert(insTraversalPath, insValuePending, NextUndoGroup());
+    insNewNode = n;
+    RecomputeLayoutAndSnap(root);
+    // Set status message based on user-entered value
+    statusMessage = "Inserted " + std::to_string(insValuePending);
+    statusTimer = 120;
+}
+
+// ---------- Start deletion traversal (non-blocking) ----------
+void StartDeletion(Key value) {
+    delTraversalIndex = 0;
+    delFramesCounter = 0;
+    delStage = DEL_TRAVERSING;
+    delTargetParent = nullptr;
+    delTargetNode = nullptr;
+    successorParent = nullptr;
+    successorNode = nullptr;
+    animNode = nullptr;
+    animReplaceNode = nullptr;
+
+    delValuePending = value;
+
+    RecordPath(root, value, delTraversalPath, true);
+    delTargetNode = delTraversalPath.found;
+    if (delTargetNode) delTargetParent = delTraversalPath.parent;
+    ExpandAlong(delTraversalPath);
+    if (!delTraversalPath.empty()) EnsureLaidOut(delTraversalPath.back());
+    RecomputeLayoutAndSnap(root);
+}
+
+// ---------- Start range deletion (one animated event) ----------
+void StartRangeDeletion(Key lo, Key hi) {
+    delTraversalPath.clear();
+    delTraversalIndex = 0;
+    delFramesCounter = 0;
+    delTargetNode = nullptr;
+    animNode = nullptr;
+    rangeFade.active = true;
+    rangeFade.lo = lo;
+    rangeFade.hi = hi;
+    rangeFade.progress = 0.0f;
+    StartTween(&rangeFade.progress, 1.0f, animDuration, EASE_CUBIC_IN_OUT);
+    delStage = DEL_RANGE_FADE;
+}
+
+// ---------- Start search traversal ----------
+void StartSearch(Key value) {
+    searchIndex = 0;
+    searchFrames = 0;
+    flashCount = 0;
+    searchStage = S_TRAVERSING;
+    searchValuePending = value;
+
+    RecordPath(root, value, searchPath, true);
+    // if not found, searchFinalNode remains nullptr
+    searchFinalNode = searchPath.found;
+    ExpandAlong(searchPath);
+    if (!searchPath.empty()) EnsureLaidOut(searchPath.back()); // rings are drawn on the whole path
+}
+
+// Counts down every pending new node and turns the expired ones SKYBLUE: O(k)
+// in the pending nodes plus one descent per expiry, instead of a tree scan.
+void UpdatePendingColors() {
+    size_t kept = 0;
+    for (const PendingColor& p : pendingColors) {
+        if (p.framesLeft > 1) {
+            pendingColors[kept++] = { p.key, p.framesLeft - 1 };
+            continue;
+        }
+        // duplicates hang to the right, so keep descending right on equal keys
+        for (Node* cur = root; cur; cur = p.key < cur->value ? cur->left : cur->right) {
+            if (cur->value == p.key && cur->color.r == RED.r && cur->color.g == RED.g && cur->color.b == RED.b) {
+                cur->color = SKYBLUE;
+                break;
+            }
+        }
+    }
+    pendingColors.resize(kept);
+}
+
+// ---------- Engine comparison mode ----------
+// M cycles off -> each engine line-up in turn -> off; every op typed (or W's
+// random workload) is posted to all engines, which apply it on their own threads.
+struct EngineLineup {
+    int count;
+    EngineKind kinds[4];
+};
+static const EngineLineup COMPARE_LINEUPS[] = {
+    { 2, { ENGINE_PLAIN_BST, ENGINE_AVL } },
+    { 4, { ENGINE_PLAIN_BST, ENGINE_AVL, ENGINE_RED_BLACK, ENGINE_SPLAY } },
+    { 1, { ENGINE_BPLUS } },
+    { 2, { ENGINE_RED_BLACK, ENGINE_BPLUS } },
+    { 1, { ENGINE_SKIP_LIST } },
+    { 4, { ENGINE_AVL, ENGINE_RED_BLACK, ENGINE_BPLUS, ENGINE_SKIP_LIST } },
+    { 1, { ENGINE_RADIX } },
+    { 2, { ENGINE_RED_BLACK, ENGINE_RADIX } },
+};
+static const int COMPARE_LINEUP_COUNT = (int)(sizeof(COMPARE_LINEUPS) / sizeof(COMPARE_LINEUPS[0]));
+static int compareLineup = -1; // -1 = mode off
+static std::vector<std::unique_ptr<EngineWorker>> compareEngines; // empty = mode off
+static const int COMPARE_WORKLOAD_OPS = 10000;
+static std::mt19937 compareWorkloadRng(0xc0ffee);
+
+void PostToEngines(const std::vector<EngineOp>& ops) {
+    for (auto& worker : compareEngines) worker->Post(ops);
+}
+
+void SetCompareLineup(int lineup) {
+    compareEngines.clear(); // joins the worker threads
+    compareLineup = lineup;
+    if (lineup < 0) return;
+    for (int i = 0; i < COMPARE_LINEUPS[lineup].count; ++i)
+        compareEngines.push_back(std::make_unique<EngineWorker>(COMPARE_LINEUPS[lineup].kinds[i]));
+    // seed with the visual tree's keys in pre-order so the plain BST starts with the same shape
+    std::vector<EngineOp> seed;
+    std::vector<Node*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        if (!IsTombstone(n)) seed.push_back({ EngineOp::INSERT, n->value });
+        if (n->right) stack.push_back(n->right);
+        if (n->left) stack.push_back(n->left);
+    }
+    PostToEngines(seed);
+}
+
+// 50% insert, 30% search, 20% delete over keys < 100000
+void PostRandomWorkload() {
+    std::vector<EngineOp> ops(COMPARE_WORKLOAD_OPS);
+    for (EngineOp& op : ops) {
+        unsigned roll = compareWorkloadRng() % 10;
+        op.kind = roll < 5 ? EngineOp::INSERT : (roll < 8 ? EngineOp::SEARCH : EngineOp::ERASE);
+        op.key = (int)(compareWorkloadRng() % 100000);
+    }
+    PostToEngines(ops);
+}
+
+// B+ tree: one box per page, as wide as the share of keys below it, with the
+// leaf chain drawn as arrows along the bottom level.
+void DrawPageSnapshot(const std::vector<EngineSnapNode>& snap, const std::vector<Key>& keys, int levels, Rectangle area) {
+    float top = area.y + 86.0f;
+    float left = area.x + 20.0f;
+    float width = area.width - 40.0f;
+    const float boxH = 22.0f;
+    float levelGap = levels > 1 ? std::min(70.0f, (area.y + area.height - 20.0f - boxH - top) / (float)(levels - 1)) : 0.0f;
+    auto box = [&](const EngineSnapNode& n) {
+        float x0 = left + n.x * width, x1 = left + (n.x + n.span) * width;
+        float pad = std::min(2.0f, (x1 - x0) / 4.0f);
+        return Rectangle{ x0 + pad, top + n.y * levelGap, std::max(x1 - x0 - 2.0f * pad, 1.0f), boxH };
+    };
+    for (const EngineSnapNode& n : snap) {
+        if (n.parent < 0) continue;
+        Rectangle c = box(n), p = box(snap[n.parent]);
+        DrawLineV({ p.x + p.width / 2, p.y + p.height }, { c.x + c.width / 2, c.y }, GRAY);
+    }
+    for (const EngineSnapNode& n : snap) {
+        Rectangle r = box(n);
+        DrawRectangleRec(r, n.red ? SKYBLUE : LIGHTGRAY);
+        DrawRectangleLines((int)r.x, (int)r.y, (int)r.width, (int)r.height, DARKBLUE);
+        std::string label;
+        for (int i = 0; i < n.keyCount; ++i) label += (i ? " " : "") + std::to_string(keys[n.firstKey + i]);
+        if (MeasureText(label.c_str(), 12) > r.width - 6 && n.keyCount > 1)
+            label = std::to_string(keys[n.firstKey]) + ".." + std::to_string(keys[n.firstKey + n.keyCount - 1]);
+        if (MeasureText(label.c_str(), 12) <= r.width - 6) DrawText(label.c_str(), (int)r.x + 3, (int)r.y + 5, 12, BLACK);
+        if (n.next >= 0) { // leaf link
+            Rectangle to = box(snap[n.next]);
+            Vector2 a = { r.x + r.width, r.y + r.height + 5 }, b = { to.x, to.y + to.height + 5 };
+            DrawLineV(a, b, DARKBLUE);
+            DrawTriangle(b, { b.x - 5, b.y - 3 }, { b.x - 5, b.y + 3 }, DARKBLUE);
+        }
+    }
+}
+
+// Skip list: one column per key with its tower stacked upwards, the head at the
+// left, and a lane on each level joining the towers tall enough to reach it.
+// The last search replays its stops one every SEARCH_STEP_FRAMES.
+void DrawTowerSnapshot(EngineWorker& worker, const std::vector<EngineSnapNode>& snap, int levels, Rectangle area) {
+    static std::vector<SkipStep> trace;
+    bool found = false;
+    uint64_t serial = worker.CopySearchTrace(trace, found);
+    if (serial != worker.traceSeen) {
+        worker.traceSeen = serial;
+        worker.traceFrames = 0;
+    }
+    int shown = std::min(worker.traceFrames / SEARCH_STEP_FRAMES + 1, (int)trace.size());
+    if (worker.traceFrames < ((int)trace.size() + 5) * SEARCH_STEP_FRAMES) worker.traceFrames++;
+    else shown = 0; // replay finished: hold for a few steps, then clear
+
+    float left = area.x + 20.0f;
+    float width = area.width - 40.0f;
+    float bottom = area.y + area.height - 28.0f;
+    float cellH = std::min(18.0f, (bottom - (area.y + 86.0f)) / (float)std::max(levels, 1));
+    float cellW = std::clamp(width / (float)(snap.size() + 1) - 2.0f, 2.0f, 34.0f);
+    auto cell = [&](float x, int level) { return Rectangle{ left + x * width, bottom - (level + 1) * cellH, cellW, cellH - 2.0f }; };
+    auto column = [&](const SkipStep& step) -> int { // -1 = head, -2 = key no longer present
+        if (step.head) return -1;
+        auto it = std::lower_bound(snap.begin(), snap.end(), step.key, [](const EngineSnapNode& n, Key k) { return n.key < k; });
+        return it != snap.end() && it->key == step.key ? (int)(it - snap.begin()) : -2;
+    };
+
+    std::vector<float> laneFrom(levels, 0.0f); // right edge of the last tower on each level
+    for (int l = 0; l < levels; ++l) laneFrom[l] = cell(0.0f, l).x + cellW;
+    for (const EngineSnapNode& n : snap) {
+        for (int l = 0; l < (int)n.y && l < levels; ++l) {
+            Rectangle r = cell(n.x, l);
+            DrawLineV({ laneFrom[l], r.y + r.height / 2 }, { r.x, r.y + r.height / 2 }, GRAY);
+            laneFrom[l] = r.x + cellW;
+            DrawRectangleRec(r, SKYBLUE);
+        }
+        if (cellW >= 20.0f) DrawText(std::to_string(n.key).c_str(), (int)(left + n.x * width), (int)bottom + 4, 12, BLACK);
+    }
+    for (int l = 0; l < levels; ++l) DrawRectangleRec(cell(0.0f, l), LIGHTGRAY);
+
+    for (int i = 0; i < shown; ++i) {
+        int c = column(trace[i]);
+        if (c == -2) continue;
+        Rectangle r = cell(c < 0 ? 0.0f : snap[c].x, trace[i].level);
+        bool current = i == shown - 1;
+        bool hit = found && i == (int)trace.size() - 1;
+        DrawRectangleRec(r, current ? (hit ? GREEN : ORANGE) : Fade(ORANGE, 0.45f));
+    }
+}
+
+// Radix tree: inner nodes are boxes naming their size and the byte they branch
+// on, each edge carries that byte's value in hex, and keys hang as leaves.
+void DrawRadixSnapshot(const std::vector<EngineSnapNode>& snap, int levels, Rectangle area) {
+    float top = area.y + 96.0f;
+    float left = area.x + 20.0f;
+    float width = area.width - 40.0f;
+    float levelGap = levels > 1 ? std::min(70.0f, (area.y + area.height - 24.0f - top) / (float)(levels - 1)) : 0.0f;
+    size_t leaves = 0;
+    for (const EngineSnapNode& n : snap) leaves += n.red;
+    float radius = std::clamp(width / (float)(leaves + 1) * 0.45f, 2.0f, 14.0f);
+    auto pos = [&](const EngineSnapNode& n) { return Vector2{ left + n.x * width, top + n.y * levelGap }; };
+    for (const EngineSnapNode& n : snap) {
+        if (n.parent < 0) continue;
+        Vector2 a = pos(snap[n.parent]), b = pos(n);
+        DrawLineV(a, b, GRAY);
+        if (levelGap >= 30.0f && radius >= 6.0f) {
+            char label[4];
+            snprintf(label, sizeof(label), "%02X", n.branch);
+            DrawText(label, (int)((a.x + b.x) / 2) + 2, (int)((a.y + b.y) / 2) - 6, 10, DARKBLUE);
+        }
+    }
+    for (const EngineSnapNode& n : snap) {
+        Vector2 p = pos(n);
+        if (n.red) {
+            DrawCircleV(p, radius, SKYBLUE);
+            if (radius >= 10.0f) DrawText(std::to_string(n.key).c_str(), (int)(p.x - radius + 2), (int)(p.y - 6), 12, BLACK);
+            continue;
+        }
+        std::string label = "N" + std::to_string(n.keyCount) + " b" + std::to_string(n.firstKey);
+        float w = (float)MeasureText(label.c_str(), 10) + 6.0f;
+        Rectangle r = { p.x - w / 2, p.y - 8.0f, w, 16.0f };
+        DrawRectangleRec(r, LIGHTGRAY);
+        DrawRectangleLines((int)r.x, (int)r.y, (int)r.width, (int)r.height, DARKBLUE);
+        DrawText(label.c_str(), (int)r.x + 3, (int)r.y + 3, 10, BLACK);
+    }
+}
+
+void DrawEngineViewport(EngineWorker& worker, Rectangle area) {
+    static std::vector<EngineSnapNode> snap;
+    static std::vector<Key> snapKeys;
+    EngineStats st = worker.Stats();
+    worker.CopySnapshot(snap, snapKeys);
+
+    DrawRectangleRec(area, WHITE);
+    DrawRectangleLines((int)area.x, (int)area.y, (int)area.width, (int)area.height, GRAY);
+    DrawText(EngineKindName(worker.kind), (int)area.x + 10, (int)area.y + 8, 20, BLACK);
+    std::string counters = "cmp " + std::to_string(st.comparisons) + "   " + EngineRestructureName(worker.kind) + " "
+        + std::to_string(st.rotations) + "   height " + std::to_string(st.height) + "   size " + std::to_string(st.size);
+    char nsText[48];
+    snprintf(nsText, sizeof(nsText), "%.1f ns/op over %llu ops", st.nsPerOp, (unsigned long long)st.ops);
+    std::string timing = nsText;
+    if (st.pending) timing += "  (" + std::to_string(st.pending) + " queued)";
+    DrawText(counters.c_str(), (int)area.x + 10, (int)area.y + 32, 16, DARKGRAY);
+    DrawText(timing.c_str(), (int)area.x + 10, (int)area.y + 50, 16, DARKGRAY);
+
+    if (st.size > EngineWorker::SNAPSHOT_LIMIT) {
+        DrawText("(tree too large to draw)", (int)area.x + 10, (int)(area.y + area.height / 2), 18, GRAY);
+        return;
+    }
+    if (snap.empty()) return;
+    if (worker.kind == ENGINE_BPLUS) {
+        DrawPageSnapshot(snap, snapKeys, st.height, area);
+        return;
+    }
+    if (worker.kind == ENGINE_SKIP_LIST) {
+        DrawTowerSnapshot(worker, snap, st.height, area);
+        return;
+    }
+    if (worker.kind == ENGINE_RADIX) {
+        DrawRadixSnapshot(snap, st.height, area);
+        return;
+    }
+    float top = area.y + 86.0f;
+    float left = area.x + 20.0f;
+    float width = area.width - 40.0f;
+    float levelGap = st.height > 1 ? std::min(60.0f, (area.y + area.height - 20.0f - top) / (float)(st.height - 1)) : 0.0f;
+    float radius = std::clamp(width / (float)(snap.size() + 1) * 0.45f, 2.0f, 14.0f);
+    auto pos = [&](const EngineSnapNode& n) { return Vector2{ left + n.x * width, top + n.y * levelGap }; };
+    for (const EngineSnapNode& n : snap)
+        if (n.parent >= 0) DrawLineV(pos(n), pos(snap[n.parent]), GRAY);
+    bool showColor = worker.kind == ENGINE_RED_BLACK;
+    for (const EngineSnapNode& n : snap) {
+        Vector2 p = pos(n);
+        DrawCircleV(p, radius, showColor ? (n.red ? RED : DARKGRAY) : SKYBLUE);
+        if (radius >= 10.0f) DrawText(std::to_string(n.key).c_str(), (int)(p.x - radius + 2), (int)(p.y - 6), 12, showColor ? WHITE : BLACK);
+    }
+}
+
+void DrawCompareViewports() {
+    float top = 165.0f, bottom = SCREEN_H - 50.0f;
+    int cols = compareEngines.size() > 1 ? 2 : 1;
+    int rows = (int)compareEngines.size() > 2 ? 2 : 1;
+    float w = (SCREEN_W - 30.0f) / cols;
+    float h = (bottom - top - 10.0f * (rows - 1)) / rows;
+    for (size_t i = 0; i < compareEngines.size(); ++i) {
+        Rectangle area = { 10.0f + (i % cols) * (w + 10.0f), top + (i / cols) * (h + 10.0f), w, h };
+        DrawEngineViewport(*compareEngines[i], area);
+    }
+}
+
+// ---------- Batch input ----------
+// The input box takes comma-separated items, each a key or lo..hi[:step]
+// (descending when lo > hi), with negative and 64-bit keys: "5, -3, 10..50:10".
+struct BatchItem {
+    Key first, last, step;
+    bool range;
+};
+
+// The animated tree's layout and drawing recurse per level, so a sorted batch
+// (a chain) is capped well below stack depth; the comparison engines are not.
+static const size_t TREE_BATCH_LIMIT = 2000;
+static const size_t COMPARE_BATCH_LIMIT = 1000000;
+static const size_t INPUT_MAX_CHARS = 4096; // room for pasted lists
+
+bool InputCharAllowed(int c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == ',' || c == '.' || c == ':' || c == ' ';
+}
+
+// Saturates at UINT64_MAX: the full 64-bit range with step 1 has 2^64 keys.
+uint64_t BatchItemCount(const BatchItem& item) {
+    uint64_t span = item.first <= item.last ? (uint64_t)item.last - (uint64_t)item.first : (uint64_t)item.first - (uint64_t)item.last;
+    uint64_t steps = span / (uint64_t)item.step;
+    return steps == UINT64_MAX ? steps : steps + 1;
+}
+
+static bool ParseKey(const char*& p, const char* end, Key& out) {
+    while (p < end && *p == ' ') p++;
+    if (p < end && *p == '+') p++;
+    auto res = std::from_chars(p, end, out);
+    if (res.ec != std::errc()) return false;
+    p = res.ptr;
+    while (p < end && *p == ' ') p++;
+    return true;
+}
+
+// Returns false with `error` set on bad syntax, a key outside 64 bits, or more
+// than `limit` keys in total.
+bool ParseBatch(const std::string& text, size_t limit, std::vector<BatchItem>& items, std::string& error) {
+    items.clear();
+    uint64_t total = 0;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) comma = text.size();
+        const char* p = text.data() + start;
+        const char* end = text.data() + comma;
+        start = comma + 1;
+        if (std::all_of(p, end, [](char c) { return c == ' '; })) continue; // empty item
+
+        BatchItem item{ 0, 0, 1, false };
+        std::string token(p, end);
+        if (!ParseKey(p, end, item.first)) { error = "Bad number in \"" + token + "\""; return false; }
+        item.last = item.first;
+        if (end - p >= 2 && p[0] == '.' && p[1] == '.') {
+            p += 2;
+            item.range = true;
+            if (!ParseKey(p, end, item.last)) { error = "Bad range end in \"" + token + "\""; return false; }
+            if (p < end && *p == ':') {
+                p++;
+                if (!ParseKey(p, end, item.step) || item.step <= 0) { error = "Step must be a positive number in \"" + token + "\""; return false; }
+            }
+        }
+        if (p != end) { error = "Unexpected text in \"" + token + "\""; return false; }
+        uint64_t count = BatchItemCount(item);
+        if (count > limit - total) { error = "Batch too large (max " + std::to_string(limit) + " keys)"; return false; }
+        total += count;
+        items.push_back(item);
+    }
+    if (items.empty()) { error = "Nothing to submit"; return false; }
+    return true;
+}
+
+void ExpandBatch(const std::vector<BatchItem>& items, std::vector<Key>& keys) {
+    keys.clear();
+    for (const BatchItem& item : items) {
+        uint64_t count = BatchItemCount(item);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t delta = i * (uint64_t)item.step;
+            keys.push_back(item.first <= item.last ? (Key)((uint64_t)item.first + delta) : (Key)((uint64_t)item.first - delta));
+        }
+    }
+}
+
+// Batches skip the per-key animation: the core operations run back to back and
+// the tree is laid out once at the end.
+size_t InsertBatch(const std::vector<Key>& keys) {
+    static PathBuffer path;
+    if (g_arena.base && g_arena.live + keys.size() >= g_arena.capacity) return 0;
+    uint32_t group = NextUndoGroup();
+    for (Key k : keys) {
+        InsertKey(root, k, path);
+        LogInsert(path, k, group);
+    }
+    RecomputeLayoutAndSnap(root);
+    return keys.size();
+}
+
+size_t DeleteBatch(const std::vector<Key>& keys) {
+    static PathBuffer path;
+    size_t removed = 0;
+    uint32_t group = NextUndoGroup();
+    FinishTweens(); // nodes may be freed or moved by compaction
+    for (Key k : keys) {
+        if (!delLazy) removed += DeleteKeyLogged(k, path, group);
+        else if (TombstoneKey(root, k, path, tombstoneCount)) {
+            LogTombstone(path, group);
+            removed++;
+        }
+    }
+    insTraversalPath.clear();
+    if (ShouldPurgeTombstones(tombstoneCount, DrawnTreeNodes())) {
+        PurgeTombstones(root, tombstoneCount);
+        ClearUndoLog();
+    }
+    MaybeCompactArena({ &root, &namedTrees[0].root, &namedTrees[1].root }, ARENA_ORDER_VEB, COMPACT_HOLE_THRESHOLD);
+    RecomputeLayoutAndSnap(root);
+    return removed;
+}
+
+size_t SearchBatch(const std::vector<Key>& keys) {
+    size_t found = 0;
+    for (Key k : keys) found += FindWithParent(root, k).second != nullptr;
+    return found;
+}
+
+// Tree generator (G): each press uses the next seed
+static const size_t GENERATE_MAX_NODES = 2000000;
+static uint64_t generateSeed = 1;
+
+// Deterministic mode (--script): one fixed step per rendered frame, live input
+// ignored, state hashed after every step.
+static bool deterministicMode = false;
+
+// ---------- Input submission ----------
+enum InputMode { MODE_INSERT, MODE_DELETE, MODE_SEARCH };
+
+// ENTER in the input box (and the script "insert/delete/search" commands).
+void SubmitInput(InputMode mode, std::string& inputText) {
+    static std::vector<BatchItem> items;
+    static std::vector<Key> keys;
+    std::string error;
+    bool comparing = !compareEngines.empty();
+    if (!ParseBatch(inputText, comparing ? COMPARE_BATCH_LIMIT : TREE_BATCH_LIMIT, items, error)) {
+        statusMessage = error;
+        statusTimer = 120;
+    }
+    else if (comparing) {
+        // comparison mode: the batch goes to every engine instead of the animated tree
+        ExpandBatch(items, keys);
+        EngineOp::Kind kind = mode == MODE_INSERT ? EngineOp::INSERT : (mode == MODE_DELETE ? EngineOp::ERASE : EngineOp::SEARCH);
+        std::vector<EngineOp> ops;
+        ops.reserve(keys.size());
+        for (Key k : keys) ops.push_back({ kind, k });
+        PostToEngines(ops);
+        statusMessage = std::string(mode == MODE_INSERT ? "Inserted " : (mode == MODE_DELETE ? "Deleted " : "Searched "))
+            + std::to_string(keys.size()) + (keys.size() == 1 ? " key" : " keys") + " in " + std::to_string(compareEngines.size()) + " engines";
+        statusTimer = 120;
+        inputText.clear();
+    }
+    else if (items.size() > 1 || items[0].range) {
+        if (delStage != DEL_IDLE || insStage != INS_IDLE || searchStage != S_IDLE) {
+            statusMessage = "Batch blocked until current animation finishes.";
+        }
+        else if (mode == MODE_DELETE && items.size() == 1 && items[0].step == 1) {
+            // a plain lo..hi is one animated range delete
+            StartRangeDeletion(std::min(items[0].first, items[0].last), std::max(items[0].first, items[0].last));
+            inputText.clear();
+        }
+        else {
+            ExpandBatch(items, keys);
+            std::string count = std::to_string(keys.size());
+            if (mode == MODE_INSERT) {
+                statusMessage = InsertBatch(keys) ? "Inserted " + count + " values" : "Batch does not fit in the node arena";
+            }
+            else if (mode == MODE_DELETE) {
+                statusMessage = "Deleted " + std::to_string(DeleteBatch(keys)) + " of " + count + " values" + (delLazy ? " (tombstone)" : "");
+            }
+            else {
+                statusMessage = "Found " + std::to_string(SearchBatch(keys)) + " of " + count + " values";
+            }
+            inputText.clear();
+        }
+        statusTimer = 120;
+    }
+    else {
+        Key v = items[0].first;
+        // Decide action based on mode, obey blocking rules:
+        bool animationsRunning = (delStage != DEL_IDLE) || (insStage != INS_IDLE) || (searchStage != S_IDLE);
+        if (mode == MODE_INSERT) {
+            // Block insert if a delete is running (stability)
+            if (delStage == DEL_IDLE && insStage == INS_IDLE) {
+                StartInsertion(v);
+                inputText.clear();
+            }
+            else {
+                statusMessage = "Insert blocked until current animation finishes.";
+                statusTimer = 120;
+            }
+        }
+        else if (mode == MODE_DELETE) {
+            if (delStage == DEL_IDLE && searchStage == S_IDLE && insStage == INS_IDLE) {
+                StartDeletion(v);
+                inputText.clear();
+            }
+            else {
+                statusMessage = "Delete blocked until current animation finishes.";
+                statusTimer = 120;
+            }
+        }
+        else { // MODE_SEARCH
+            if (delStage == DEL_IDLE && insStage == INS_IDLE && searchStage == S_IDLE) {
+                StartSearch(v);
+                inputText.clear();
+            }
+            else {
+                statusMessage = "Search blocked until current animation finishes.";
+                statusTimer = 120;
+            }
+        }
+    }
+}
+
+// G / Shift+G: replace the tree with a generated random / balanced one of
+// N nodes (N typed in the input box, default 1000)
+void GenerateFromInput(std::string& inputText, GenShape shape) {
+    if (delStage == DEL_IDLE && insStage == INS_IDLE && searchStage == S_IDLE) {
+        static std::vector<BatchItem> items;
+        std::string error;
+        Key requested = 1000;
+        if (ParseBatch(inputText, TREE_BATCH_LIMIT, items, error) && items.size() == 1 && !items[0].range && items[0].first > 0)
+            requested = items[0].first;
+        size_t n = (size_t)std::min<Key>(requested, (Key)GENERATE_MAX_NODES);
+        size_t drawn = DrawnTreeNodes(); // freed first; A and B stay
+        if (!ArenaHasRoom(n > drawn ? n - drawn : 0)) {
+            statusMessage = ArenaFullMessage(n - drawn) + " (A and B hold " + std::to_string(namedTrees[0].size + namedTrees[1].size) + ")";
+            statusTimer = 120;
+            return;
+        }
+        insTraversalPath.clear();
+        delTraversalPath.clear();
+        searchPath.clear();
+        insNewNode = nullptr;
+        tombstoneCount = 0;
+        FinishTweens();
+        auto t0 = std::chrono::steady_clock::now();
+        GenerateTree(root, n, generateSeed, shape);
+        ClearUndoLog();
+        RecomputeLayoutAndSnap(root);
+        long long ms = (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+        statusMessage = "Generated " + std::string(GenShapeName(shape)) + " tree: " + std::to_string(n) + " nodes, height "
+            + std::to_string(TreeHeight(root)) + ", seed " + std::to_string(generateSeed);
+        // wall-clock time would make deterministic runs render differently
+        if (!deterministicMode) statusMessage += ", " + std::to_string(ms) + " ms";
+        generateSeed++;
+        inputText.clear();
+    }
+    else statusMessage = "Generate waits until current animation finishes.";
+    statusTimer = 120;
+}
+
+// C: relocate nodes into van Emde Boas order (only while nothing is animating,
+// since the state machines and tweens hold raw Node pointers)
+void CompactIfIdle() {
+    if (delStage == DEL_IDLE && insStage == INS_IDLE && searchStage == S_IDLE && tweenCount == 0) {
+        insTraversalPath.clear();
+        CompactArena({ &root, &namedTrees[0].root, &namedTrees[1].root }, ARENA_ORDER_VEB);
+        RecomputeLayoutAndSnap(root); // node addresses changed
+        statusMessage = "Compacted " + std::to_string(g_arena.live) + " nodes into vEB order";
+    }
+    else statusMessage = "Compaction waits until current animation finishes.";
+    statusTimer = 120;
+}
+
+// Ctrl+Z / Ctrl+Y (and the script "undo" / "redo" commands)
+void UndoIfIdle(bool redo) {
+    if (delStage != DEL_IDLE || insStage != INS_IDLE || searchStage != S_IDLE) {
+        statusMessage = std::string(redo ? "Redo" : "Undo") + " waits until current animation finishes.";
+    }
+    else if (size_t applied = UndoStep(redo)) {
+        statusMessage = std::string(redo ? "Redid " : "Undid ") + std::to_string(applied) + (applied == 1 ? " change" : " changes")
+            + " (" + std::to_string(undoCursor) + " undo, " + std::to_string(undoLog.size() - undoCursor) + " redo left)";
+    }
+    else statusMessage = redo ? "Nothing to redo" : "Nothing to undo";
+    statusTimer = 120;
+}
+
+// ---------- Named trees and set operations ----------
+// A / B store a treap copy of the drawn tree; Shift+A / Shift+B draw a copy of
+// it again. U, I and E replace the drawn tree with A union B, A intersect B and
+// A minus B, computed join-based on copies so A and B are kept. K draws B with
+// what changed since A highlighted.
+bool TreeIdle() {
+    return delStage == DEL_IDLE && insStage == INS_IDLE && searchStage == S_IDLE && tweenCount == 0;
+}
+
+// Swaps in a new drawn tree, dropping everything that pointed into the old one.
+void ReplaceDrawnTree(Node* newRoot) {
+    insTraversalPath.clear();
+    delTraversalPath.clear();
+    searchPath.clear();
+    insNewNode = nullptr;
+    tombstoneCount = 0;
+    diffRemovedText.clear();
+    FinishTweens();
+    FreeTree(root);
+    root = newRoot;
+    ClearUndoLog();
+    RecomputeLayoutAndSnap(root);
+}
+
+void StoreNamedTree(int slot) {
+    NamedTree& t = namedTrees[slot];
+    if (BST_MERKLE && t.root && MerkleOf(root) == t.source) {
+        statusMessage = std::string(1, (char)('A' + slot)) + " already holds this tree (" + std::to_string(t.size) + " keys)";
+        statusTimer = 120;
+        return;
+    }
+    size_t drawn = DrawnTreeNodes(); // the copy replaces t
+    if (!ArenaHasRoom(drawn > t.size ? drawn - t.size : 0)) {
+        statusMessage = ArenaFullMessage(drawn - t.size) + ", " + (char)('A' + slot) + " unchanged";
+        statusTimer = 120;
+        return;
+    }
+    FreeTree(t.root);
+    t.root = CopyAsTreap(root);
+    t.source = MerkleOf(root);
+#if BST_MERKLE
+    t.size = MeasureShape(t.root).nodes;
+#else
+    t.size = DigestTree(t.root, t.digests).size;
+#endif
+    statusMessage = std::string("Stored the tree as ") + (char)('A' + slot) + " (" + std::to_string(t.size) + " keys)";
+    statusTimer = 120;
+}
+
+void LoadNamedTree(int slot) {
+    if (!TreeIdle()) statusMessage = "Loading waits until current animation finishes.";
+    else if (!ArenaHasRoom(namedTrees[slot].size)) statusMessage = ArenaFullMessage(namedTrees[slot].size);
+    else {
+        ReplaceDrawnTree(CopyAsTreap(namedTrees[slot].root));
+        statusMessage = std::string("Showing ") + (char)('A' + slot) + " (" + std::to_string(namedTrees[slot].size) + " keys)";
+    }
+    statusTimer = 120;
+}
+
+void RunSetOperation(SetOp op) {
+    if (!TreeIdle()) {
+        statusMessage = "Set operations wait until current animation finishes.";
+        statusTimer = 120;
+        return;
+    }
+    if (!ArenaHasRoom(namedTrees[0].size + namedTrees[1].size)) { // both operands are copied
+        statusMessage = ArenaFullMessage(namedTrees[0].size + namedTrees[1].size);
+        statusTimer = 120;
+        return;
+    }
+    Node* a = CopyAsTreap(namedTrees[0].root);
+    Node* b = CopyAsTreap(namedTrees[1].root);
+    TaskPool& pool = SharedTaskPool();
+    std::vector<Node*> dropped;
+    auto t0 = std::chrono::steady_clock::now();
+    Node* result = SetOperation(op, a, b, &pool, dropped);
+    long long us = (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    for (Node* d : dropped) FreeTree(d);
+    ReplaceDrawnTree(result);
+    static const char* symbols[] = { "A union B", "A intersect B", "A minus B" };
+    statusMessage = std::string(symbols[op]) + ": " + std::to_string(MeasureShape(root).nodes) + " keys (A " + std::to_string(namedTrees[0].size)
+        + ", B " + std::to_string(namedTrees[1].size) + ")";
+    // wall-clock time would make deterministic runs render differently
+    if (!deterministicMode) statusMessage += ", " + std::to_string(us) + " us on " + std::to_string(pool.Concurrency())
+        + (pool.Concurrency() == 1 ? " thread" : " threads");
+    statusTimer = 120;
+}
+
+// Diff A -> B: B is drawn with added keys green and the nodes above them whose
+// subtree changed orange; removed keys are listed beside the named trees.
+void RunTreeDiff() {
+    if (!TreeIdle()) {
+        statusMessage = "Diff waits until current animation finishes.";
+        statusTimer = 120;
+        return;
+    }
+    if (!ArenaHasRoom(namedTrees[1].size)) { // B is drawn as a copy
+        statusMessage = ArenaFullMessage(namedTrees[1].size);
+        statusTimer = 120;
+        return;
+    }
+    TreeDiff diff;
+    auto t0 = std::chrono::steady_clock::now();
+#if BST_MERKLE
+    DiffTreaps(namedTrees[0].root, nullptr, namedTrees[1].root, nullptr, diff);
+#else
+    DiffTreaps(namedTrees[0].root, &namedTrees[0].digests, namedTrees[1].root, &namedTrees[1].digests, diff);
+#endif
+    long long us = (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+    ReplaceDrawnTree(CopyAsTreap(namedTrees[1].root));
+    std::sort(diff.changed.begin(), diff.changed.end());
+    auto has = [](const std::vector<Key>& keys, Key k) { return std::binary_search(keys.begin(), keys.end(), k); };
+    std::vector<Node*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        if (has(diff.added, n->value)) n->color = GREEN;
+        else if (has(diff.changed, n->value)) n->color = ORANGE;
+        if (n->left) stack.push_back(n->left);
+        if (n->right) stack.push_back(n->right);
+    }
+    if (!diff.removed.empty()) {
+        diffRemovedText = "Removed:";
+        size_t shown = std::min<size_t>(diff.removed.size(), 8);
+        for (size_t i = 0; i < shown; ++i) diffRemovedText += " " + std::to_string(diff.removed[i]);
+        if (shown < diff.removed.size()) diffRemovedText += " ... (" + std::to_string(diff.removed.size() - shown) + " more)";
+    }
+    statusMessage = "A -> B: +" + std::to_string(diff.added.size()) + " -" + std::to_string(diff.removed.size()) + ", "
+        + std::to_string(diff.identicalSubtrees) + " identical subtrees"
+        + (BST_MERKLE ? std::string() : " (" + std::to_string(diff.identicalNodes) + " keys)") + " skipped, "
+        + std::to_string(diff.visited) + " nodes compared";
+    if (!deterministicMode) statusMessage += ", " + std::to_string(us) + " us";
+    statusTimer = 120;
+}
+
+// ---------- Simulation step ----------
+// Everything that advances the state machines and animations runs in fixed
+// SIM_DT steps, independent of the render rate.
+static const float SIM_DT = 1.0f / 60.0f;
+static const int SIM_MAX_STEPS_PER_FRAME = 4; // after a stall, drop the backlog instead of spiralling
+static uint64_t simStep = 0;
+
+void StepSimulation() {
+    // ---------- Insert state machine ----------
+    if (insStage == INS_TRAVERSING) {
+        insFramesCounter++;
+        if (insFramesCounter >= INS_STEP_FRAMES) {
+            insFramesCounter = 0;
+            if (insTraversalIndex < (int)insTraversalPath.size()) {
+                insTraversalIndex++;
+            }
+            else {
+                // attach node now; it stays red on its own timer, so the next insert can start
+                insStage = INS_ATTACHING;
+                AttachNewNodeFromPending();
+                insNewNode = nullptr;
+                insStage = INS_IDLE;
+            }
+        }
+    }
+
+    // ---------- Delete state machine ----------
+    if (delStage == DEL_TRAVERSING) {
+        delFramesCounter++;
+        if (delFramesCounter >= DEL_STEP_FRAMES) {
+            delFramesCounter = 0;
+            if (delTraversalIndex < (int)delTraversalPath.size()) {
+                delTraversalIndex++;
+            }
+            else {
+                if (!delTargetNode) {
+                    // Not found -> show message using user-entered value
+                    statusMessage = "Value " + std::to_string(delValuePending) + " not found for deletion";
+                    statusTimer = 120;
+                    delStage = DEL_IDLE;
+                    delTraversalPath.clear();
+                    delTraversalIndex = 0;
+                }
+                else if (delLazy) {
+                    // tombstone: no successor move / relink, just mark and fade
+                    SetTombstone(delTargetNode, true);
+                    RefreshUp(delTargetNode);
+                    LogTombstone(delTraversalPath, NextUndoGroup());
+                    tombstoneCount++;
+                    delTargetNode = nullptr;
+                    statusMessage = "Deleted " + std::to_string(delValuePending) + " (tombstone)";
+                    statusTimer = 120;
+                    delStage = DEL_FINALIZE;
+                    delFramesCounter = 0;
+                }
+                else {
+                    delStage = DEL_HIGHLIGHT_TARGET;
+                    delFramesCounter = 0;
+                }
+            }
+        }
+    }
+    else if (delStage == DEL_HIGHLIGHT_TARGET) {
+        delFramesCounter++;
+        if (delFramesCounter >= 30) {
+            // decide deletion case
+            if (!delTargetNode->left && !delTargetNode->right) {
+                // leaf
+                delStage = DEL_SHRINK_REMOVE;
+                animNode = delTargetNode;
+                animAlpha = 1.0f;
+                StartTween(&animNode->radius, 0.0f, animDuration / 1.5f, EASE_CUBIC_IN_OUT);
+                StartTween(&animAlpha, 0.0f, animDuration / 1.5f, EASE_LINEAR);
+            }
+            else if (delTargetNode->left && delTargetNode->right) {
+                // successorNode/successorParent hold the replacement, which
+                // comes from the left (predecessor) when the policy says so
+                delReplaceFromLeft = !ReplaceFromSuccessor(delTargetNode);
+                auto pr = delReplaceFromLeft ? FindInorderPredecessor(delTargetNode) : FindInorderSuccessor(delTargetNode);
+                successorParent = pr.first ? pr.first : delTargetNode;
+                successorNode = pr.second;
+                if (successorNode) delStage = DEL_HIGHLIGHT_SUCCESSOR;
+                else delStage = DEL_FINALIZE;
+                delFramesCounter = 0;
+            }
+            else {
+                // one-child
+                delStage = DEL_MOVE_CHILD_UP;
+                if (delTargetNode->left) animNode = delTargetNode->left;
+                else animNode = delTargetNode->right;
+                EnsureLaidOut(animNode);
+                StartTween(&animNode->animX, delTargetNode->x, animDuration, EASE_BACK_OUT);
+                StartTween(&animNode->animY, delTargetNode->y, animDuration, EASE_BACK_OUT);
+            }
+        }
+    }
+    else if (delStage == DEL_HIGHLIGHT_SUCCESSOR) {
+        delFramesCounter++;
+        if (delFramesCounter >= 30) {
+            // start moving successor
+            delStage = DEL_MOVE_SUCCESSOR;
+            animNode = successorNode;
+            EnsureLaidOut(successorNode);
+            animReplaceNode = delTargetNode;
+            StartTween(&animNode->animX, delTargetNode->x, animDuration, EASE_CUBIC_IN_OUT);
+            StartTween(&animNode->animY, delTargetNode->y, animDuration, EASE_CUBIC_IN_OUT);
+        }
+    }
+    else if (delStage == DEL_MOVE_SUCCESSOR) {
+        if (!Tweening(&animNode->animX) && !Tweening(&animNode->animY)) {
+            // copy value and remove successor structurally
+            LogRemoval(delTraversalPath, successorNode, delReplaceFromLeft, NextUndoGroup());
+            FinishTweens(); // the freed successor may still be growing back from an undo
+            if (delReplaceFromLeft) RemoveByPredecessorCopy(root, delTargetNode, successorParent, successorNode);
+            else RemoveBySuccessorCopy(root, delTargetNode, successorParent, successorNode);
+            successorNode = nullptr;
+            successorParent = nullptr;
+            animNode = nullptr; animReplaceNode = nullptr;
+            RecomputeLayoutAndSnap(root);
+            delStage = DEL_FINALIZE;
+            delFramesCounter = 0;
+            // show success message using user-entered value
+            statusMessage = "Deleted " + std::to_string(delValuePending);
+            statusTimer = 120;
+        }
+    }
+    else if (delStage == DEL_MOVE_CHILD_UP) {
+        if (!Tweening(&animNode->animX) && !Tweening(&animNode->animY)) {
+            LogRemoval(delTraversalPath, nullptr, false, NextUndoGroup());
+            FinishTweens();
+            SpliceOut(root, delTargetParent, delTargetNode);
+            delTargetNode = nullptr;
+            animNode = nullptr;
+            RecomputeLayoutAndSnap(root);
+            delStage = DEL_FINALIZE;
+            // success message using user-entered value
+            statusMessage = "Deleted " + std::to_string(delValuePending);
+            statusTimer = 120;
+        }
+    }
+    else if (delStage == DEL_SHRINK_REMOVE) {
+        if (!animNode) delStage = DEL_FINALIZE;
+        else {
+            animNode->color = Fade(RED, animAlpha);
+            if (!Tweening(&animNode->radius)) {
+                LogRemoval(delTraversalPath, nullptr, false, NextUndoGroup());
+                FinishTweens();
+                SpliceOut(root, delTargetParent, animNode);
+                animNode = nullptr;
+                delTargetNode = nullptr;
+                RecomputeLayoutAndSnap(root);
+                delStage = DEL_FINALIZE;
+                statusMessage = "Deleted " + std::to_string(delValuePending);
+                statusTimer = 120;
+            }
+        }
+    }
+    else if (delStage == DEL_RANGE_FADE) {
+        if (!Tweening(&rangeFade.progress)) {
+            FinishTweens();
+            size_t removed = DeleteRange(root, rangeFade.lo, rangeFade.hi, tombstoneCount);
+            if (removed) ClearUndoLog(); // relinks whole subtrees; not logged
+            rangeFade.active = false;
+            RecomputeLayoutAndSnap(root);
+            statusMessage = removed
+                ? "Deleted " + std::to_string(removed) + " values in [" + std::to_string(rangeFade.lo) + ", " + std::to_string(rangeFade.hi) + "]"
+                : "No values in [" + std::to_string(rangeFade.lo) + ", " + std::to_string(rangeFade.hi) + "]";
+            statusTimer = 120;
+            delStage = DEL_FINALIZE;
+            delFramesCounter = 0;
+        }
+    }
+    else if (delStage == DEL_FINALIZE) {
+        delFramesCounter++;
+        if (delFramesCounter > 20) {
+            delStage = DEL_IDLE;
+            delTraversalPath.clear();
+            delTraversalIndex = 0;
+            delFramesCounter = 0;
+            if (insStage == INS_IDLE && searchStage == S_IDLE) {
+                insTraversalPath.clear();
+                FinishTweens(); // purge and compaction free / move nodes
+                if (ShouldPurgeTombstones(tombstoneCount, DrawnTreeNodes())) {
+                    size_t purged = tombstoneCount;
+                    PurgeTombstones(root, tombstoneCount);
+                    ClearUndoLog();
+                    RecomputeLayoutAndSnap(root);
+                    statusMessage = "Rebuilt tree, removed " + std::to_string(purged) + " tombstones";
+                    statusTimer = 120;
+                }
+                if (MaybeCompactArena({ &root, &namedTrees[0].root, &namedTrees[1].root }, ARENA_ORDER_VEB, COMPACT_HOLE_THRESHOLD)) RecomputeLayoutAndSnap(root);
+            }
+        }
+    }
+
+    // ---------- Search state machine ----------
+    if (searchStage == S_TRAVERSING) {
+        // Block if deletion or insertion currently animating (Option 2)
+        if (delStage != DEL_IDLE || insStage != INS_IDLE) {
+            // wait
+        }
+        else {
+            searchFrames++;
+            if (searchFrames >= SEARCH_STEP_FRAMES) {
+                searchFrames = 0;
+                if (searchIndex < (int)searchPath.size()) {
+                    searchIndex++;
+                }
+                else {
+                    if (searchPath.empty()) {
+                        searchStage = S_FLASH_NOTFOUND;
+                        searchFinalNode = nullptr;
+                        statusMessage = "Not found " + std::to_string(searchValuePending);
+                        statusTimer = 120;
+                    }
+                    else {
+                        if (searchFinalNode != nullptr) {
+                            searchStage = S_FLASH_FOUND;
+                            statusMessage = "Found " + std::to_string(searchValuePending);
+                            statusTimer = 120;
+                        }
+                        else {
+                            searchStage = S_FLASH_NOTFOUND;
+                            searchFinalNode = searchPath.back();
+                            statusMessage = "Not found " + std::to_string(searchValuePending);
+                            statusTimer = 120;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    else if (searchStage == S_FLASH_FOUND) {
+        searchFrames++;
+        if (searchFrames >= FLASH_FRAMES) {
+            searchFrames = 0;
+            flashCount++;
+            if (flashCount >= 6) { // 3 flashes (on/off)
+                searchStage = S_IDLE;
+                searchPath.clear();
+                searchIndex = 0;
+                flashCount = 0;
+                searchFinalNode = nullptr;
+            }
+        }
+    }
+    else if (searchStage == S_FLASH_NOTFOUND) {
+        searchFrames++;
+        if (searchFrames >= FLASH_FRAMES) {
+            searchFrames = 0;
+            flashCount++;
+            if (flashCount >= 6) {
+                searchStage = S_IDLE;
+                searchPath.clear();
+                searchIndex = 0;
+                flashCount = 0;
+                searchFinalNode = nullptr;
+            }
+        }
+    }
+
+    // newly inserted nodes turn blue as their timers run out
+    UpdatePendingColors();
+
+    // decrement status message timer
+    if (statusTimer > 0) {
+        statusTimer--;
+        if (statusTimer == 0) statusMessage.clear();
+    }
+
+    // Smooth move; under load easing runs every other step with a doubled step
+    // (1 - (1 - 0.18)^2) so motion keeps its speed
+    if (quality.level < QUALITY_HALF_RATE_ANIMATION) {
+        if (lazyLayout) SmoothMoveVisible();
+        else SmoothMoveAll(root);
+    }
+    else if (simStep % 2 == 0) {
+        const float easing = 1.0f - (1.0f - 0.18f) * (1.0f - 0.18f);
+        if (lazyLayout) SmoothMoveVisible(easing);
+        else SmoothMoveAll(root, easing);
+    }
+    // tweens last, so a node being animated is not pulled back toward its slot
+    UpdateTweens();
+    simStep++;
+}
+
+
+// ---------- Deterministic mode: state hash and scripts ----------
+static void HashBytes(uint64_t& h, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull; // FNV-1a
+    }
+}
+
+template <class T>
+static void HashValue(uint64_t& h, const T& v) { HashBytes(h, &v, sizeof(v)); }
+
+// Tree shape, keys, tags, layout and animated positions, plus the state
+// machines, quality level and status line; equal hashes mean identical frames.
+uint64_t HashSimulationState() {
+    uint64_t h = 1469598103934665603ull;
+    static std::vector<Node*> stack;
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+        Node* n = stack.back();
+        stack.pop_back();
+        if (!n) { HashValue(h, (uint8_t)0); continue; }
+        HashValue(h, (uint8_t)1);
+        HashValue(h, n->value);
+        HashValue(h, n->left.Tag());
+        HashValue(h, n->right.Tag());
+        float geometry[5] = { n->x, n->y, n->animX, n->animY, n->radius };
+        HashBytes(h, geometry, sizeof(geometry));
+        HashValue(h, n->color);
+        stack.push_back(n->right);
+        stack.push_back(n->left);
+    }
+    int stages[] = { insStage, insTraversalIndex, insFramesCounter, (int)pendingColors.size(), delStage, delTraversalIndex, delFramesCounter,
+                     searchStage, searchIndex, searchFrames, flashCount, statusTimer, quality.level };
+    HashBytes(h, stages, sizeof(stages));
+    for (const PendingColor& p : pendingColors) {
+        HashValue(h, p.key);
+        HashValue(h, p.framesLeft);
+    }
+    for (int i = 0; i < tweenCount; ++i) {
+        float tween[4] = { tweens[i].from, tweens[i].to, tweens[i].t, tweens[i].dt };
+        HashBytes(h, tween, sizeof(tween));
+        HashValue(h, tweens[i].curve);
+    }
+    HashValue(h, animAlpha);
+    HashValue(h, rangeFade.progress);
+    HashValue(h, tombstoneCount);
+    HashBytes(h, statusMessage.data(), statusMessage.size());
+    return h;
+}
+
+// One script line: "<step> <command> [argument]", run before simulation step <step>.
+// Commands: insert|delete|search <batch>, generate <n> [balanced], policy <name>,
+// tombstone on|off, autocollapse <depth>, compact, undo, redo, store a|b, show a|b,
+// setop union|intersection|difference, diff, quit. '#' starts a comment.
+struct ScriptCommand {
+    uint64_t step;
+    std::string verb;
+    std::string arg;
+};
+static std::vector<ScriptCommand> script;
+static size_t scriptNext = 0;
+
+bool LoadScript(const char* path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) { error = std::string("cannot open ") + path; return false; }
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        ScriptCommand cmd;
+        if (!(fields >> cmd.step)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            error = std::string(path) + ":" + std::to_string(lineNo) + ": expected a step number";
+            return false;
+        }
+        static const char* verbs[] = { "insert", "delete", "search", "generate", "policy", "tombstone", "autocollapse", "compact", "undo", "redo", "store", "show", "setop", "diff", "quit" };
+        fields >> cmd.verb;
+        if (std::find_if(std::begin(verbs), std::end(verbs), [&](const char* v) { return cmd.verb == v; }) == std::end(verbs)) {
+            error = std::string(path) + ":" + std::to_string(lineNo) + ": unknown command '" + cmd.verb + "'";
+            return false;
+        }
+        std::getline(fields >> std::ws, cmd.arg);
+        while (!cmd.arg.empty() && (cmd.arg.back() == '\r' || cmd.arg.back() == ' ')) cmd.arg.pop_back();
+        if (!script.empty() && cmd.step < script.back().step) {
+            error = std::string(path) + ":" + std::to_string(lineNo) + ": steps must not decrease";
+            return false;
+        }
+        script.push_back(cmd);
     }
-    // if not found, searchFinalNode remains nullptr
+    return true;
 }
 
-// Utility: recursively finalize RED->SKYBLUE after insertion if timer elapsed
-void FinalizeNewNodes(Node* n) {
-    if (!n) return;
-    if (n->color.r == RED.r && n->color.g == RED.g && n->color.b == RED.b) {
-        n->color = SKYBLUE;
-        return;
+// Runs the commands due at the current step; returns false once "quit" is reached.
+bool RunScriptCommands() {
+    while (scriptNext < script.size() && script[scriptNext].step <= simStep) {
+        const ScriptCommand& cmd = script[scriptNext++];
+        std::string text = cmd.arg;
+        if (cmd.verb == "quit") return false;
+        else if (cmd.verb == "insert") SubmitInput(MODE_INSERT, text);
+        else if (cmd.verb == "delete") SubmitInput(MODE_DELETE, text);
+        else if (cmd.verb == "search") SubmitInput(MODE_SEARCH, text);
+        else if (cmd.verb == "generate") {
+            size_t space = text.find(' ');
+            bool balanced = space != std::string::npos && text.substr(space + 1) == "balanced";
+            text = text.substr(0, space);
+            GenerateFromInput(text, balanced ? GEN_BALANCED : GEN_RANDOM);
+        }
+        else if (cmd.verb == "policy") {
+            int p = 0;
+            while (p < DELETE_POLICY_COUNT && text != DeletePolicyName((DeletePolicy)p)) p++;
+            if (p < DELETE_POLICY_COUNT) g_deletePolicy = (DeletePolicy)p;
+            else statusMessage = "Unknown delete policy '" + text + "'";
+            statusTimer = 120;
+        }
+        else if (cmd.verb == "tombstone") delLazy = text == "on";
+        else if (cmd.verb == "autocollapse") {
+            autoCollapseDepth = std::max(0, std::atoi(text.c_str()));
+            RecomputeLayoutAndSnap(root);
+        }
+        else if (cmd.verb == "compact") CompactIfIdle();
+        else if (cmd.verb == "undo" || cmd.verb == "redo") UndoIfIdle(cmd.verb == "redo");
+        else if (cmd.verb == "store" || cmd.verb == "show") {
+            if (text == "a" || text == "b") {
+                if (cmd.verb == "store") StoreNamedTree(text == "b");
+                else LoadNamedTree(text == "b");
+            }
+            else {
+                statusMessage = "Unknown tree '" + text + "' (a or b)";
+                statusTimer = 120;
+            }
+        }
+        else if (cmd.verb == "diff") RunTreeDiff();
+        else if (cmd.verb == "setop") {
+            int op = 0;
+            while (op <= SET_DIFFERENCE && text != SetOpName((SetOp)op)) op++;
+            if (op <= SET_DIFFERENCE) RunSetOperation((SetOp)op);
+            else {
+                statusMessage = "Unknown set operation '" + text + "'";
+                statusTimer = 120;
+            }
+        }
     }
-    FinalizeNewNodes(n->left);
-    FinalizeNewNodes(n->right);
+    return true;
 }
 
 // ---------- Main ----------
-int main() {
+int main(int argc, char** argv) {
+    // bst_vis [--script file] [--hash-log file] [--seed n] [--undo-kb n] [--undo-animation on|off]
+    const char* scriptPath = nullptr;
+    const char* hashLogPath = nullptr;
+    for (int i = 1; i < argc; i += 2) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) flag.clear(); // every flag takes a value
+        if (flag == "--script") scriptPath = argv[i + 1];
+        else if (flag == "--hash-log") hashLogPath = argv[i + 1];
+        else if (flag == "--seed") {
+            uint64_t seed = std::strtoull(argv[i + 1], nullptr, 10);
+            g_deletePolicyRng.seed((unsigned)seed);
+            compareWorkloadRng.seed((unsigned)seed);
+            generateSeed = seed;
+        }
+        else if (flag == "--undo-kb") undoBudgetBytes = (size_t)std::strtoull(argv[i + 1], nullptr, 10) * 1024;
+        else if (flag == "--undo-animation") undoAnimation = std::string(argv[i + 1]) != "off";
+        else {
+            std::cerr << "usage: " << argv[0] << " [--script file] [--hash-log file] [--seed n] [--undo-kb n] [--undo-animation on|off]" << std::endl;
+            return 1;
+        }
+    }
+    if (scriptPath) {
+        std::string error;
+        if (!LoadScript(scriptPath, error)) {
+            std::cerr << "script: " << error << std::endl;
+            return 1;
+        }
+        deterministicMode = true;
+        lazyLayout = false; // what gets laid out would depend on the (live) camera
+        // the governor follows wall-clock frame time, so frames would differ between runs
+        quality.automatic = false;
+        quality.level = QUALITY_FULL;
+    }
+    std::ofstream hashLog;
+    if (hashLogPath) hashLog.open(hashLogPath);
+    float simAccumulator = 0.0f;
+
     InitWindow(SCREEN_W, SCREEN_H, "BST Visualizer - Final (values displayed as entered by user)");
     SetTargetFPS(60);
 
@@ -356,7 +5047,7 @@ int main() {
     Rectangle searchBtn = { 360 + 180, 70, 140, 40 }; // placed to the right
     std::string inputText = "";
     bool inputFocused = false;
-    enum Mode { MODE_INSERT, MODE_DELETE, MODE_SEARCH } mode = MODE_INSERT;
+    InputMode mode = MODE_INSERT;
 
     // camera
     Camera2D camera = { 0 };
@@ -368,10 +5059,12 @@ int main() {
     int insertFinalize = 0;
 
     while (!WindowShouldClose()) {
+        auto frameStart = std::chrono::steady_clock::now();
         Vector2 mouse = GetMousePosition();
+        bool liveInput = !deterministicMode; // scripted runs ignore keyboard and mouse (camera excepted)
 
         // UI input focus click
-        if (CheckCollisionPointRec(mouse, inputBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+        if (liveInput && CheckCollisionPointRec(mouse, inputBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             inputFocused = true;
         }
         if (!CheckCollisionPointRec(mouse, inputBox) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
@@ -380,7 +5073,7 @@ int main() {
 
         // Buttons clicked detection
         bool insertClicked = false, deleteClicked = false, searchClicked = false;
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+        if (liveInput && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             if (CheckCollisionPointRec(mouse, insertBtn)) insertClicked = true;
             if (CheckCollisionPointRec(mouse, deleteBtn)) deleteClicked = true;
             if (CheckCollisionPointRec(mouse, searchBtn)) searchClicked = true;
@@ -393,46 +5086,19 @@ int main() {
         if (inputFocused) {
             int key = GetCharPressed();
             while (key > 0) {
-                if ((key >= '0' && key <= '9') && inputText.size() < 7) inputText.push_back((char)key);
+                if (InputCharAllowed(key) && inputText.size() < INPUT_MAX_CHARS) inputText.push_back((char)key);
                 key = GetCharPressed();
             }
             if (IsKeyPressed(KEY_BACKSPACE) && !inputText.empty()) inputText.pop_back();
-            if (IsKeyPressed(KEY_ENTER) && !inputText.empty()) {
-                int v = std::stoi(inputText);
-                // Decide action based on mode, obey blocking rules:
-                bool animationsRunning = (delStage != DEL_IDLE) || (insStage != INS_IDLE && insStage != INS_FINALIZE) || (searchStage != S_IDLE);
-                if (mode == MODE_INSERT) {
-                    // Block insert if a delete is running (stability)
-                    if (delStage == DEL_IDLE && insStage == INS_IDLE) {
-                        StartInsertion(v);
-                        inputText.clear();
-                    }
-                    else {
-                        statusMessage = "Insert blocked until current animation finishes.";
-                        statusTimer = 120;
-                    }
-                }
-                else if (mode == MODE_DELETE) {
-                    if (delStage == DEL_IDLE && searchStage == S_IDLE && insStage == INS_IDLE) {
-                        StartDeletion(v);
-                        inputText.clear();
-                    }
-                    else {
-                        statusMessage = "Delete blocked until current animation finishes.";
-                        statusTimer = 120;
-                    }
-                }
-                else { // MODE_SEARCH
-                    if (delStage == DEL_IDLE && insStage == INS_IDLE && searchStage == S_IDLE) {
-                        StartSearch(v);
-                        inputText.clear();
-                    }
-                    else {
-                        statusMessage = "Search blocked until current animation finishes.";
-                        statusTimer = 120;
-                    }
+            // Ctrl+V pastes; line breaks, tabs and semicolons become list separators
+            if ((IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) && IsKeyPressed(KEY_V)) {
+                const char* clip = GetClipboardText();
+                for (const char* c = clip; c && *c && inputText.size() < INPUT_MAX_CHARS; ++c) {
+                    char ch = (*c == '\n' || *c == '\r' || *c == '\t' || *c == ';') ? ',' : *c;
+                    if (InputCharAllowed((unsigned char)ch)) inputText.push_back(ch);
                 }
             }
+            if (IsKeyPressed(KEY_ENTER) && !inputText.empty()) SubmitInput(mode, inputText);
         }
 
         // camera controls
@@ -440,283 +5106,139 @@ int main() {
         if (IsKeyDown(KEY_LEFT))  camera.target.x -= 8;
         if (IsKeyDown(KEY_UP))    camera.target.y -= 8;
         if (IsKeyDown(KEY_DOWN))  camera.target.y += 8;
-        camera.zoom += GetMouseWheelMove() * 0.05f;
-        if (camera.zoom < 0.2f) camera.zoom = 0.2f;
-        if (camera.zoom > 3.0f) camera.zoom = 3.0f;
-
-        // ---------- Insert state machine ----------
-        if (insStage == INS_TRAVERSING) {
-            insFramesCounter++;
-            if (insFramesCounter >= INS_STEP_FRAMES) {
-                insFramesCounter = 0;
-                if (insTraversalIndex < (int)insTraversalPath.size()) {
-                    insTraversalIndex++;
-                }
-                else {
-                    // attach node now
-                    insStage = INS_ATTACHING;
-                    AttachNewNodeFromPending();
-                    // after attaching, go to finalize stage where the new node will become blue for 120 frames
-                    insStage = INS_FINALIZE;
-                }
-            }
-        }
-        else if (insStage == INS_FINALIZE) {
-            if (insFinalizeTimer > 0) {
-                insFinalizeTimer--;
-                if (insFinalizeTimer == 0) {
-                    FinalizeNewNodes(root);
-                    insNewNode = nullptr;
-                    insStage = INS_IDLE;
-                }
-            }
+        // M: comparison mode off -> each engine line-up -> off
+        if (liveInput && IsKeyPressed(KEY_M)) {
+            SetCompareLineup(compareLineup + 1 < COMPARE_LINEUP_COUNT ? compareLineup + 1 : -1);
+            statusMessage = compareEngines.empty() ? "Comparison mode off" : "Comparing";
+            for (size_t i = 0; i < compareEngines.size(); ++i) statusMessage += std::string(i ? ", " : " ") + EngineKindName(compareEngines[i]->kind);
+            if (!compareEngines.empty()) statusMessage += " (W: random workload)";
+            statusTimer = 120;
         }
 
-        // ---------- Delete state machine ----------
-        if (delStage == DEL_TRAVERSING) {
-            delFramesCounter++;
-            if (delFramesCounter >= DEL_STEP_FRAMES) {
-                delFramesCounter = 0;
-                if (delTraversalIndex < (int)delTraversalPath.size()) {
-                    delTraversalIndex++;
-                }
-                else {
-                    if (!delTargetNode) {
-                        // Not found -> show message using user-entered value
-                        statusMessage = "Value " + std::to_string(delValuePending) + " not found for deletion";
-                        statusTimer = 120;
-                        delStage = DEL_IDLE;
-                        delTraversalPath.clear();
-                        delTraversalIndex = 0;
-                    }
-                    else {
-                        delStage = DEL_HIGHLIGHT_TARGET;
-                        delFramesCounter = 0;
-                    }
-                }
-            }
-        }
-        else if (delStage == DEL_HIGHLIGHT_TARGET) {
-            delFramesCounter++;
-            if (delFramesCounter >= 30) {
-                // decide deletion case
-                if (!delTargetNode->left && !delTargetNode->right) {
-                    // leaf
-                    delStage = DEL_SHRINK_REMOVE;
-                    animNode = delTargetNode;
-                    animProgress = 0;
-                }
-                else if (delTargetNode->left && delTargetNode->right) {
-                    auto pr = FindInorderSuccessor(delTargetNode);
-                    successorParent = pr.first ? pr.first : delTargetNode;
-                    successorNode = pr.second;
-                    if (successorNode) delStage = DEL_HIGHLIGHT_SUCCESSOR;
-                    else delStage = DEL_FINALIZE;
-                    delFramesCounter = 0;
-                }
-                else {
-                    // one-child
-                    delStage = DEL_MOVE_CHILD_UP;
-                    if (delTargetNode->left) animNode = delTargetNode->left;
-                    else animNode = delTargetNode->right;
-                    moveStartX = animNode->animX; moveStartY = animNode->animY;
-                    moveTargetX = delTargetNode->x; moveTargetY = delTargetNode->y;
-                    animProgress = 0;
-                }
-            }
-        }
-        else if (delStage == DEL_HIGHLIGHT_SUCCESSOR) {
-            delFramesCounter++;
-            if (delFramesCounter >= 30) {
-                // start moving successor
-                delStage = DEL_MOVE_SUCCESSOR;
-                animNode = successorNode;
-                animReplaceNode = delTargetNode;
-                moveStartX = successorNode->animX; moveStartY = successorNode->animY;
-                moveTargetX = delTargetNode->x; moveTargetY = delTargetNode->y;
-                animProgress = 0;
-            }
-        }
-        else if (delStage == DEL_MOVE_SUCCESSOR) {
-            animProgress += 1.0f / animDuration;
-            if (animProgress > 1.0f) animProgress = 1.0f;
-            animNode->animX = moveStartX + (moveTargetX - moveStartX) * animProgress;
-            animNode->animY = moveStartY + (moveTargetY - moveStartY) * animProgress;
-            if (animProgress >= 1.0f) {
-                // copy value and remove successor structurally
-                delTargetNode->value = successorNode->value;
-                // unlink successor
-                if (successorParent->left == successorNode) successorParent->left = successorNode->right;
-                else if (successorParent->right == successorNode) successorParent->right = successorNode->right;
-                DeleteNodePointer(successorNode);
-                successorNode = nullptr;
-                successorParent = nullptr;
-                animNode = nullptr; animReplaceNode = nullptr;
-                RecomputeLayoutAndSnap(root);
-                delStage = DEL_FINALIZE;
-                delFramesCounter = 0;
-                // show success message using user-entered value
-                statusMessage = "Deleted " + std::to_string(delValuePending);
-                statusTimer = 120;
-            }
+        // W: post a random mixed workload to every engine
+        if (liveInput && IsKeyPressed(KEY_W) && !compareEngines.empty()) {
+            PostRandomWorkload();
+            statusMessage = "Posted " + std::to_string(COMPARE_WORKLOAD_OPS) + " random ops to each engine";
+            statusTimer = 120;
         }
-        else if (delStage == DEL_MOVE_CHILD_UP) {
-            animProgress += 1.0f / animDuration;
-            if (animProgress > 1.0f) animProgress = 1.0f;
-            animNode->animX = moveStartX + (moveTargetX - moveStartX) * animProgress;
-            animNode->animY = moveStartY + (moveTargetY - moveStartY) * animProgress;
-            if (animProgress >= 1.0f) {
-                Node* parent = delTargetParent;
-                if (!parent) {
-                    // root
-                    if (delTargetNode->left) root = delTargetNode->left;
-                    else root = delTargetNode->right;
-                }
-                else {
-                    if (parent->left == delTargetNode) {
-                        if (delTargetNode->left) parent->left = delTargetNode->left;
-                        else parent->left = delTargetNode->right;
-                    }
-                    else if (parent->right == delTargetNode) {
-                        if (delTargetNode->left) parent->right = delTargetNode->left;
-                        else parent->right = delTargetNode->right;
-                    }
-                }
-                DeleteNodePointer(delTargetNode);
-                delTargetNode = nullptr;
-                animNode = nullptr;
-                RecomputeLayoutAndSnap(root);
-                delStage = DEL_FINALIZE;
-                // success message using user-entered value
-                statusMessage = "Deleted " + std::to_string(delValuePending);
-                statusTimer = 120;
-            }
+
+        // G / Shift+G: replace the tree with a generated random / balanced one of
+        // N nodes (N typed in the input box, default 1000)
+        if (liveInput && IsKeyPressed(KEY_G)) GenerateFromInput(inputText, (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) ? GEN_BALANCED : GEN_RANDOM);
+
+        // P: cycle the two-children delete policy
+        if (liveInput && IsKeyPressed(KEY_P)) {
+            g_deletePolicy = (DeletePolicy)((g_deletePolicy + 1) % DELETE_POLICY_COUNT);
+            statusMessage = std::string("Delete replacement: ") + DeletePolicyName(g_deletePolicy);
+            statusTimer = 120;
         }
-        else if (delStage == DEL_SHRINK_REMOVE) {
-            if (!animNode) delStage = DEL_FINALIZE;
-            else {
-                animProgress += 1.0f / (animDuration / 1.5f);
-                animNode->radius = 25.0f * (1.0f - animProgress);
-                animNode->color = Fade(RED, 1.0f - animProgress);
-                if (animProgress >= 1.0f) {
-                    Node* parent = delTargetParent;
-                    // show deleted value using pending
-                    if (!parent) {
-                        DeleteNodePointer(root);
-                    }
-                    else {
-                        if (parent->left == animNode) parent->left = nullptr;
-                        else if (parent->right == animNode) parent->right = nullptr;
-                        DeleteNodePointer(animNode);
-                    }
-                    animNode = nullptr;
-                    delTargetNode = nullptr;
-                    RecomputeLayoutAndSnap(root);
-                    delStage = DEL_FINALIZE;
-                    statusMessage = "Deleted " + std::to_string(delValuePending);
-                    statusTimer = 120;
-                }
-            }
+
+        // T: toggle tombstone (lazy) delete mode
+        if (liveInput && IsKeyPressed(KEY_T)) {
+            delLazy = !delLazy;
+            statusMessage = delLazy ? "Delete mode: tombstone (lazy)" : "Delete mode: immediate";
+            statusTimer = 120;
         }
-        else if (delStage == DEL_FINALIZE) {
-            delFramesCounter++;
-            if (delFramesCounter > 20) {
-                delStage = DEL_IDLE;
-                delTraversalPath.clear();
-                delTraversalIndex = 0;
-                delFramesCounter = 0;
-            }
+
+        // click a node to select it (a collapsed one also expands), click empty
+        // space to clear; right-click a node to collapse its subtree
+        bool leftClick = IsMouseButtonPressed(MOUSE_LEFT_BUTTON), rightClick = IsMouseButtonPressed(MOUSE_RIGHT_BUTTON);
+        if (liveInput && compareEngines.empty() && (leftClick || rightClick) && mouse.y > 160) {
+            NodePick pick = PickNode(root, GetScreenToWorld2D(mouse, camera));
+            if (pick.node && (pick.node->left || pick.node->right) && IsCollapsed(pick.node, pick.depth) == leftClick)
+                ToggleCollapse(pick);
+            if (leftClick) SelectNode(pick.node, pick.depth);
         }
 
-        // ---------- Search state machine ----------
-        if (searchStage == S_TRAVERSING) {
-            // Block if deletion or insertion currently animating (Option 2)
-            if (delStage != DEL_IDLE || insStage != INS_IDLE) {
-                // wait
-            }
-            else {
-                searchFrames++;
-                if (searchFrames >= SEARCH_STEP_FRAMES) {
-                    searchFrames = 0;
-                    if (searchIndex < (int)searchPath.size()) {
-                        searchIndex++;
-                    }
-                    else {
-                        if (searchPath.empty()) {
-                            searchStage = S_FLASH_NOTFOUND;
-                            searchFinalNode = nullptr;
-                            statusMessage = "Not found " + std::to_string(searchValuePending);
-                            statusTimer = 120;
-                        }
-                        else {
-                            if (searchFinalNode != nullptr) {
-                                searchStage = S_FLASH_FOUND;
-                                statusMessage = "Found " + std::to_string(searchValuePending);
-                                statusTimer = 120;
-                            }
-                            else {
-                                searchStage = S_FLASH_NOTFOUND;
-                                searchFinalNode = searchPath.back();
-                                statusMessage = "Not found " + std::to_string(searchValuePending);
-                                statusTimer = 120;
-                            }
-                        }
-                    }
-                }
-            }
+        // S / X: search for / delete the selected node's key
+        bool searchSelected = IsKeyPressed(KEY_S), deleteSelected = IsKeyPressed(KEY_X);
+        if (liveInput && compareEngines.empty() && (searchSelected || deleteSelected) && SelectedNode()) {
+            std::string keyText = std::to_string(selection.key);
+            SubmitInput(searchSelected ? MODE_SEARCH : MODE_DELETE, keyText);
         }
-        else if (searchStage == S_FLASH_FOUND) {
-            searchFrames++;
-            if (searchFrames >= FLASH_FRAMES) {
-                searchFrames = 0;
-                flashCount++;
-                if (flashCount >= 6) { // 3 flashes (on/off)
-                    searchStage = S_IDLE;
-                    searchPath.clear();
-                    searchIndex = 0;
-                    flashCount = 0;
-                    searchFinalNode = nullptr;
-                }
-            }
+
+        // D: auto-collapse depth (off, 4, 6, ... 12)
+        if (liveInput && IsKeyPressed(KEY_D)) {
+            autoCollapseDepth = autoCollapseDepth >= 12 ? 0 : (autoCollapseDepth == 0 ? 4 : autoCollapseDepth + 2);
+            RecomputeLayoutAndSnap(root);
+            statusMessage = autoCollapseDepth ? "Auto-collapse below depth " + std::to_string(autoCollapseDepth) : "Auto-collapse off";
+            statusTimer = 120;
         }
-        else if (searchStage == S_FLASH_NOTFOUND) {
-            searchFrames++;
-            if (searchFrames >= FLASH_FRAMES) {
-                searchFrames = 0;
-                flashCount++;
-                if (flashCount >= 6) {
-                    searchStage = S_IDLE;
-                    searchPath.clear();
-                    searchIndex = 0;
-                    flashCount = 0;
-                    searchFinalNode = nullptr;
-                }
-            }
+
+        // Q: quality governor automatic / fixed at full quality
+        if (liveInput && IsKeyPressed(KEY_Q)) {
+            quality.automatic = !quality.automatic;
+            if (!quality.automatic) quality.level = QUALITY_FULL;
+            statusMessage = quality.automatic ? "Quality governor on" : "Quality governor off (full quality)";
+            statusTimer = 120;
         }
 
-        // finalize inserted nodes color when timer runs out (ensures node stays blue for 2 seconds)
-        if (insFinalizeTimer > 0) {
-            insFinalizeTimer--;
-            if (insFinalizeTimer == 0) {
-                FinalizeNewNodes(root);
-                insNewNode = nullptr;
-                insStage = INS_IDLE;
-            }
+        // L: lazy (viewport-only) vs full layout
+        if (liveInput && IsKeyPressed(KEY_L)) {
+#if BST_PARENT_LINKS
+            lazyLayout = !lazyLayout;
+            RecomputeLayoutAndSnap(root);
+            statusMessage = lazyLayout ? "Layout: visible subtrees only" : "Layout: full tree";
+#else
+            statusMessage = "Lazy layout needs BST_PARENT_LINKS";
+#endif
+            statusTimer = 120;
         }
 
-        // decrement status message timer
-        if (statusTimer > 0) {
-            statusTimer--;
-            if (statusTimer == 0) statusMessage.clear();
+        // C: compact node memory
+        if (liveInput && IsKeyPressed(KEY_C)) CompactIfIdle();
+
+        // A / B: store the tree as A / B (Shift: draw A / B); U / I / E: A union /
+        // intersect / minus B
+        for (int slot = 0; slot < 2; ++slot) {
+            if (!liveInput || !compareEngines.empty() || !IsKeyPressed(slot ? KEY_B : KEY_A)) continue;
+            if (IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) LoadNamedTree(slot);
+            else StoreNamedTree(slot);
         }
+        if (liveInput && compareEngines.empty() && IsKeyPressed(KEY_U)) RunSetOperation(SET_UNION);
+        if (liveInput && compareEngines.empty() && IsKeyPressed(KEY_I)) RunSetOperation(SET_INTERSECTION);
+        if (liveInput && compareEngines.empty() && IsKeyPressed(KEY_E)) RunSetOperation(SET_DIFFERENCE);
+        // K: diff A -> B
+        if (liveInput && compareEngines.empty() && IsKeyPressed(KEY_K)) RunTreeDiff();
+
+        // Ctrl+Z: undo, Ctrl+Y / Ctrl+Shift+Z: redo
+        bool ctrl = IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL);
+        bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+        if (liveInput && compareEngines.empty() && ctrl && (IsKeyPressed(KEY_Z) || IsKeyPressed(KEY_Y)))
+            UndoIfIdle(IsKeyPressed(KEY_Y) || shift);
+        camera.zoom += GetMouseWheelMove() * 0.05f;
+        if (camera.zoom < 0.2f) camera.zoom = 0.2f;
+        if (camera.zoom > 3.0f) camera.zoom = 3.0f;
+
+        // lazy layout works in world space: what the camera currently shows
+        Vector2 viewMin = GetScreenToWorld2D({ 0, 0 }, camera);
+        Vector2 viewMax = GetScreenToWorld2D({ (float)SCREEN_W, (float)SCREEN_H }, camera);
+        layoutView = { viewMin.x, viewMin.y, viewMax.x - viewMin.x, viewMax.y - viewMin.y };
 
-        // Smooth move
-        SmoothMoveAll(root);
+        // ---------- Simulation ----------
+        if (deterministicMode) {
+            // exactly one step per rendered frame, so the same script gives the same frames
+            if (!RunScriptCommands()) break;
+            StepSimulation();
+            if (hashLog) hashLog << simStep << ' ' << std::hex << HashSimulationState() << std::dec << '\n';
+        }
+        else {
+            simAccumulator += GetFrameTime();
+            int steps = 0;
+            while (simAccumulator >= SIM_DT && steps < SIM_MAX_STEPS_PER_FRAME) {
+                StepSimulation();
+                simAccumulator -= SIM_DT;
+                steps++;
+            }
+            if (steps == SIM_MAX_STEPS_PER_FRAME) simAccumulator = 0.0f;
+        }
 
         // ---------- Drawing ----------
         BeginDrawing();
         ClearBackground(RAYWHITE);
 
+        drawZoom = camera.zoom;
+        lodDepth = LodDepth(drawZoom);
         BeginMode2D(camera);
 
         // Determine del highlight node
@@ -742,20 +5264,14 @@ int main() {
             searchCurrent = searchPath[idx];
         }
 
+        SelectedNode(); // drop or re-resolve a selection the last step invalidated
+
         // Composite drawing: pass delHighlight as primary highlight, then draw search rings and insert rings separately
         DrawTree(root, delHighlight, animNode);
 
         // Draw insertion traversal rings (visited nodes remain yellow while traversing)
-        if (insStage == INS_TRAVERSING) {
-            // populate traversal list if empty (edge case)
-            if (insTraversalPath.empty() && root) {
-                Node* tmp = root;
-                while (tmp) {
-                    insTraversalPath.push_back(tmp);
-                    if (insValuePending < tmp->value) tmp = tmp->left;
-                    else tmp = tmp->right;
-                }
-            }
+        bool rings = quality.level < QUALITY_NO_RINGS;
+        if (rings && insStage == INS_TRAVERSING) {
             for (int i = 0; i < std::min(insTraversalIndex, (int)insTraversalPath.size()); ++i) {
                 Node* n = insTraversalPath[i];
                 DrawCircle((int)n->animX, (int)n->animY, n->radius + 6, Fade(YELLOW, 0.85f));
@@ -763,7 +5279,7 @@ int main() {
         }
 
         // Draw search visited rings
-        if (searchStage == S_TRAVERSING || searchStage == S_FLASH_FOUND || searchStage == S_FLASH_NOTFOUND) {
+        if (rings && (searchStage == S_TRAVERSING || searchStage == S_FLASH_FOUND || searchStage == S_FLASH_NOTFOUND)) {
             for (int i = 0; i < std::min(searchIndex, (int)searchPath.size()); ++i) {
                 Node* n = searchPath[i];
                 DrawCircle((int)n->animX, (int)n->animY, n->radius + 6, Fade(YELLOW, 0.85f));
@@ -782,6 +5298,8 @@ int main() {
 
         EndMode2D();
 
+        if (!compareEngines.empty()) DrawCompareViewports();
+
         // UI top
         DrawRectangle(0, 0, SCREEN_W, 160, LIGHTGRAY);
         DrawText("BST Visualizer - Insert / Delete (Option C) / Search (Option C) - Final", 20, 18, 18, BLACK);
@@ -801,8 +5319,11 @@ int main() {
         // Input box
         DrawRectangleRec(inputBox, WHITE);
         DrawRectangleLines((int)inputBox.x, (int)inputBox.y, (int)inputBox.width, (int)inputBox.height, BLACK);
-        DrawText(inputText.c_str(), (int)inputBox.x + 8, (int)inputBox.y + 6, 20, BLACK);
-        std::string modeHint = (mode == MODE_INSERT) ? "(insert mode)" : (mode == MODE_DELETE ? "(delete mode)" : "(search mode)");
+        // long batches scroll: show the tail that fits
+        size_t shownFrom = inputText.size() > 64 ? inputText.size() - 64 : 0;
+        while (shownFrom < inputText.size() && MeasureText(inputText.c_str() + shownFrom, 20) > (int)inputBox.width - 16) shownFrom++;
+        DrawText(inputText.c_str() + shownFrom, (int)inputBox.x + 8, (int)inputBox.y + 6, 20, BLACK);
+        std::string modeHint = (mode == MODE_INSERT) ? "(insert mode)" : (mode == MODE_DELETE ? (delLazy ? "(delete mode, tombstone)" : "(delete mode)") : "(search mode)");
         DrawText(modeHint.c_str(), (int)inputBox.x + 8, (int)(inputBox.y + inputBox.height + 4), 14, DARKGRAY);
 
         // Status message area (center top)
@@ -813,42 +5334,731 @@ int main() {
             DrawText(statusMessage.c_str(), SCREEN_W / 2 - width / 2, 128, 20, BLACK);
         }
 
+        // selected node: its subtree at a glance
+        if (SelectedNode()) {
+            std::string info = "Selected " + std::to_string(selection.key) + " (depth " + std::to_string(selection.depth) + "): subtree "
+                + std::to_string(selection.live) + (selection.live == 1 ? " node" : " nodes") + ", height " + std::to_string(selection.height)
+                + ", keys [" + std::to_string(selection.lo) + ".." + std::to_string(selection.hi) + "]   S: search   X: delete";
+            DrawRectangle(10, SCREEN_H - 78, MeasureText(info.c_str(), 18) + 20, 28, Fade(VIOLET, 0.25f));
+            DrawText(info.c_str(), 20, SCREEN_H - 73, 18, BLACK);
+        }
+
         // small instructions
         DrawText("Arrow keys to pan, mouse wheel to zoom.", 620, 100, 16, DARKGRAY);
+        DrawText("Batches: 5, -3, 10..50:10   Ctrl+V pastes", 700, 76, 16, DARKGRAY);
+        std::string hotkeys = std::string("T: tombstone deletes (") + (delLazy ? "on" : "off") + ")   P: delete policy ("
+            + DeletePolicyName(g_deletePolicy) + ")   L: lazy layout (" + (lazyLayout ? "on" : "off") + ")   D: auto-collapse depth ("
+            + (autoCollapseDepth ? std::to_string(autoCollapseDepth) : std::string("off")) + ")";
+        DrawText("C: compact   G/Shift+G: random/balanced tree of N   M: compare engines   W: workload   Q: quality   Ctrl+Z/Y: undo/redo   Click: select/expand   Right-click: collapse", 20, SCREEN_H - 44, 16, DARKGRAY);
+        DrawText(hotkeys.c_str(), 20, SCREEN_H - 24, 16, DARKGRAY);
+
+        // quality governor: frame work up to the buffer swap (EndDrawing also waits
+        // out the target frame time, so only a long wall-clock frame counts beyond that)
+        std::string qualityText = "Quality: " + std::string(QualityLevelName(quality.level)) + (quality.automatic ? " (auto)" : " (fixed)");
+        if (!deterministicMode) qualityText += "   " + std::to_string(GetFPS()) + " fps";
+        DrawText(qualityText.c_str(), SCREEN_W - 20 - MeasureText(qualityText.c_str(), 16), 20, 16, DARKGRAY);
+        std::string namedText = "Tree A: " + std::to_string(namedTrees[0].size) + " keys   B: " + std::to_string(namedTrees[1].size) + " keys";
+        const char* namedKeys[] = { namedText.c_str(), "A/B: store (Shift: show)", "U/I/E: A union/intersect/minus B   K: diff A -> B", diffRemovedText.c_str() };
+        for (int i = 0; i < 4; ++i) DrawText(namedKeys[i], SCREEN_W - 20 - MeasureText(namedKeys[i], 16), 44 + 22 * i, 16, DARKGRAY);
+        float workMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
 
         EndDrawing();
 
+        float frameMs = GetFrameTime() * 1000.0f;
+        quality.Update(frameMs > FRAME_BUDGET_MS * 1.25f ? std::max(workMs, frameMs) : workMs);
+
         // After draw: handle button clicks that set focus/mode
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+        if (liveInput && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
             if (CheckCollisionPointRec(mouse, insertBtn)) { inputFocused = true; mode = MODE_INSERT; }
             if (CheckCollisionPointRec(mouse, deleteBtn)) { inputFocused = true; mode = MODE_DELETE; }
             if (CheckCollisionPointRec(mouse, searchBtn)) { inputFocused = true; mode = MODE_SEARCH; }
         }
 
-        // --- Advance insTraversalPath population at start of insStage ---
-        if (insStage == INS_TRAVERSING && insTraversalPath.empty()) {
-            if (root) {
-                Node* tmp = root;
-                while (tmp) {
-                    insTraversalPath.push_back(tmp);
-                    if (insValuePending < tmp->value) tmp = tmp->left;
-                    else tmp = tmp->right;
-                }
-            }
-            insTraversalIndex = 0;
+    } // main loop
+
+    if (deterministicMode) std::cout << "steps " << simStep << " state hash " << std::hex << HashSimulationState() << std::dec << std::endl;
+
+    // Cleanup tree (engine threads are joined first)
+    compareEngines.clear();
+    FreeTree(root);
+    root = nullptr;
+    for (NamedTree& t : namedTrees) FreeTree(t.root);
+
+    CloseWindow();
+    return 0;
+}
+
+#else // BST_HEADLESS
+
+// ---------- Headless benchmark driver ----------
+#include <cstdio>
+
+static double NsPerOp(std::chrono::steady_clock::time_point start, size_t ops) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return ops ? (double)ns / (double)ops : 0.0;
+}
+
+// Random insert / search / delete of n distinct keys on the plain BST.
+void RunOpsBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    Node* tree = nullptr;
+    PathBuffer path;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int k : keys) InsertKey(tree, k, path);
+    double insNs = NsPerOp(t0, n);
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+    size_t hits = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int k : keys) hits += FindWithParent(tree, k).second != nullptr;
+    double searchNs = NsPerOp(t0, n);
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+    t0 = std::chrono::steady_clock::now();
+    for (int k : keys) DeleteKey(tree, k, path);
+    double delNs = NsPerOp(t0, n);
+
+    std::printf("ops n=%zu node=%zuB parent_links=%d merkle=%d\n", n, sizeof(Node), BST_PARENT_LINKS, BST_MERKLE);
+    std::printf("  insert %.1f ns/op, search %.1f ns/op (%zu hits), delete %.1f ns/op, live after=%u\n",
+        insNs, searchNs, hits, delNs, g_arena.live);
+}
+
+// Resident huge-page bytes of this process (Linux THP accounting); -1 if unknown.
+long long AnonHugePagesKb() {
+#if defined(__linux__)
+    FILE* f = std::fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return -1;
+    char line[256];
+    long long kb = -1;
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::sscanf(line, "AnonHugePages: %lld kB", &kb) == 1) break;
+    }
+    std::fclose(f);
+    return kb;
+#else
+    return -1;
+#endif
+}
+
+// Search latency on an n-node random tree, once per arena page mode.
+void RunHugePagesBench(size_t n, uint64_t seed) {
+    const size_t queries = 2000000;
+    const ArenaPageMode modes[] = { ARENA_PAGES_NORMAL, ARENA_PAGES_TRANSPARENT_HUGE, ARENA_PAGES_EXPLICIT_HUGE };
+    std::printf("hugepages n=%zu node=%zuB queries=%zu\n", n, sizeof(Node), queries);
+    for (ArenaPageMode mode : modes) {
+        ArenaRelease();
+        g_arenaConfig.pages = mode;
+        g_arenaConfig.slots = (uint32_t)std::min<size_t>(n + 1, NodeLink::INDEX_MASK);
+
+        std::mt19937_64 rng(seed);
+        Node* tree = nullptr;
+        PathBuffer path;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i) InsertKey(tree, (int)(rng() >> 33), path);
+        double buildNs = NsPerOp(t0, n);
+
+        // Each query key depends on the previous result so lookups cannot overlap.
+        uint64_t x = seed;
+        size_t hits = 0;
+        t0 = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < queries; ++q) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull + hits;
+            hits += FindWithParent(tree, (int)(x >> 33)).second != nullptr;
         }
+        double searchNs = NsPerOp(t0, queries);
+        std::printf("  requested %-16s got %-16s build %.1f ns/op  search %.1f ns/op (%zu hits)  AnonHugePages %lld kB\n",
+            ArenaPageModeName(mode), ArenaPageModeName(g_arena.pages), buildNs, searchNs, hits, AnonHugePagesKb());
+        FreeTree(tree);
+    }
+    ArenaRelease();
+    g_arenaConfig = ArenaConfig();
+}
 
-    } // main loop
+// Dependent random lookups of keys known to be in the tree.
+double MeasureSearchNs(Node* tree, const std::vector<int>& keys, size_t queries, uint64_t seed) {
+    uint64_t x = seed;
+    size_t hits = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t q = 0; q < queries; ++q) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull + hits;
+        hits += FindWithParent(tree, keys[(x >> 20) % keys.size()]).second != nullptr;
+    }
+    double ns = NsPerOp(t0, queries);
+    if (hits != queries) std::printf("  (warning: %zu of %zu lookups missed)\n", queries - hits, queries);
+    return ns;
+}
 
-    // Cleanup tree
-    std::function<void(Node*)> cleanup = [&](Node* n) {
-        if (!n) return;
-        cleanup(n->left);
-        cleanup(n->right);
-        delete n;
+// Search latency after n delete+insert churn rounds, then after compaction in each order.
+void RunDefragBench(size_t n, uint64_t seed) {
+    const size_t queries = 2000000;
+    std::mt19937_64 rng(seed);
+    std::vector<int> keys;
+    keys.reserve(n);
+    Node* tree = nullptr;
+    PathBuffer path;
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back((int)(rng() >> 33));
+        InsertKey(tree, keys.back(), path);
+    }
+    std::printf("defrag n=%zu node=%zuB queries=%zu\n", n, sizeof(Node), queries);
+    auto report = [&](const char* label) {
+        std::printf("  %-14s search %.1f ns/op  scatter %.2f  holes %.2f\n", label,
+            MeasureSearchNs(tree, keys, queries, seed), MeasureLinkScatter(tree), ArenaHoleRatio());
         };
-    cleanup(root);
+    report("fresh");
 
-    CloseWindow();
+    // Churn: every round deletes a random live key and inserts a new one, so
+    // recycled slots land at unrelated tree positions.
+    for (size_t i = 0; i < n; ++i) {
+        size_t idx = rng() % keys.size();
+        DeleteKey(tree, keys[idx], path);
+        keys[idx] = (int)(rng() >> 33);
+        InsertKey(tree, keys[idx], path);
+    }
+    // Then drop a quarter of the keys to leave holes.
+    for (size_t i = 0; i < n / 4; ++i) {
+        DeleteKey(tree, keys.back(), path);
+        keys.pop_back();
+    }
+    report("churned");
+
+    auto t0 = std::chrono::steady_clock::now();
+    CompactArena({ &tree }, ARENA_ORDER_BFS);
+    std::printf("  compact bfs took %.1f ms\n", NsPerOp(t0, 1) / 1e6);
+    report("bfs order");
+
+    t0 = std::chrono::steady_clock::now();
+    CompactArena({ &tree }, ARENA_ORDER_VEB);
+    std::printf("  compact veb took %.1f ms\n", NsPerOp(t0, 1) / 1e6);
+    report("veb order");
+    FreeTree(tree);
+}
+
+// Delete half of an n-node tree key by key: eager relinking vs tombstones with
+// batched purges.
+void RunTombstoneBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::vector<int> victims(keys.begin(), keys.begin() + n / 2);
+    std::shuffle(victims.begin(), victims.end(), rng);
+    std::printf("tombstone n=%zu deletes=%zu purge ratio=%.2f\n", n, victims.size(), TOMBSTONE_PURGE_RATIO);
+
+    PathBuffer path;
+    Node* tree = nullptr;
+    for (int k : keys) InsertKey(tree, k, path);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int k : victims) DeleteKey(tree, k, path);
+    std::printf("  eager      %.1f ns/delete\n", NsPerOp(t0, victims.size()));
+    FreeTree(tree);
+
+    tree = nullptr;
+    for (int k : keys) InsertKey(tree, k, path);
+    size_t tombstones = 0, purges = 0, treeNodes = n;
+    double purgeMs = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int k : victims) {
+        TombstoneKey(tree, k, path, tombstones);
+        if (ShouldPurgeTombstones(tombstones, treeNodes)) {
+            auto p0 = std::chrono::steady_clock::now();
+            treeNodes -= tombstones;
+            PurgeTombstones(tree, tombstones);
+            purgeMs += NsPerOp(p0, 1) / 1e6;
+            purges++;
+        }
+    }
+    std::printf("  tombstone  %.1f ns/delete incl. %zu purges totalling %.1f ms (%zu still marked)\n",
+        NsPerOp(t0, victims.size()), purges, purgeMs, tombstones);
+    FreeTree(tree);
+}
+
+// Delete 100 random ranges of ~n/1000 keys each: one DeleteRange per range vs
+// one DeleteKey per key.
+void RunRangeDeleteBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = (int)i;
+    std::shuffle(keys.begin(), keys.end(), rng);
+    const int ranges = 100;
+    const int width = (int)std::max<size_t>(1, n / 1000);
+    std::vector<int> starts(ranges);
+    for (int& lo : starts) lo = (int)(rng() % n);
+
+    PathBuffer path;
+    size_t tombstones = 0;
+    Node* tree = nullptr;
+    for (int k : keys) InsertKey(tree, k, path);
+    size_t removed = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int lo : starts) removed += DeleteRange(tree, lo, lo + width - 1, tombstones);
+    double rangeNs = NsPerOp(t0, removed);
+    FreeTree(tree);
+
+    tree = nullptr;
+    for (int k : keys) InsertKey(tree, k, path);
+    size_t removedOneByOne = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int lo : starts)
+        for (int k = lo; k < lo + width; ++k) removedOneByOne += DeleteKey(tree, k, path);
+    double perKeyNs = NsPerOp(t0, removedOneByOne);
+    FreeTree(tree);
+
+    std::printf("range n=%zu ranges=%d width=%d\n", n, ranges, width);
+    std::printf("  DeleteRange   %.1f ns per removed key (%zu removed)\n", rangeNs, removed);
+    std::printf("  per-key       %.1f ns per removed key (%zu removed)\n", perKeyNs, removedOneByOne);
+}
+
+// Long random delete+insert churn on an n-key tree under each two-children
+// delete policy; n*n rounds (capped) is where Hibbard skew shows.
+void RunChurnBench(size_t n, uint64_t seed) {
+    const size_t rounds = std::min<size_t>(n * n, 20000000);
+    std::printf("churn n=%zu rounds=%zu  (log2 n = %.1f, sqrt n = %.1f)\n", n, rounds, std::log2((double)n), std::sqrt((double)n));
+    for (int p = 0; p < DELETE_POLICY_COUNT; ++p) {
+        g_deletePolicy = (DeletePolicy)p;
+        g_deletePolicyRng.seed((unsigned)seed);
+        std::mt19937_64 rng(seed);
+        std::vector<int> keys(n);
+        Node* tree = nullptr;
+        PathBuffer path;
+        for (int& k : keys) {
+            k = (int)(rng() >> 33);
+            InsertKey(tree, k, path);
+        }
+        ShapeStats start = MeasureShape(tree);
+        std::printf("  %-12s start h=%d avg=%.1f |", DeletePolicyName(g_deletePolicy), start.height, start.avgDepth);
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t r = 1; r <= rounds; ++r) {
+            size_t idx = rng() % n;
+            DeleteKey(tree, keys[idx], path);
+            keys[idx] = (int)(rng() >> 33);
+            InsertKey(tree, keys[idx], path);
+            if (r % (rounds / 4) == 0) {
+                ShapeStats st = MeasureShape(tree);
+                std::printf(" h=%d avg=%.1f", st.height, st.avgDepth);
+            }
+        }
+        std::printf(" | %.0f ns/round\n", NsPerOp(t0, rounds));
+        FreeTree(tree);
+    }
+    g_deletePolicy = DELETE_SUCCESSOR;
+}
+
+// Same op streams applied by every comparison engine on its own thread.
+void RunCompareBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<EngineOp> mixed(n);
+    for (EngineOp& op : mixed) {
+        unsigned roll = (unsigned)(rng() % 10);
+        op.kind = roll < 5 ? EngineOp::INSERT : (roll < 8 ? EngineOp::SEARCH : EngineOp::ERASE);
+        op.key = (int)(rng() % (2 * n + 1));
+    }
+    // ascending inserts are the plain BST's worst case, so keep that stream short
+    std::vector<EngineOp> ascending(std::min<size_t>(n, 10000));
+    for (size_t i = 0; i < ascending.size(); ++i) ascending[i] = { EngineOp::INSERT, (int)i };
+
+    struct Workload { const char* name; const std::vector<EngineOp>* ops; };
+    for (Workload w : { Workload{ "random 50/30/20", &mixed }, Workload{ "ascending", &ascending } }) {
+        std::printf("compare %s, %zu ops\n", w.name, w.ops->size());
+        std::vector<std::unique_ptr<EngineWorker>> workers;
+        for (int k = 0; k < ENGINE_KIND_COUNT; ++k) workers.push_back(std::make_unique<EngineWorker>((EngineKind)k));
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& worker : workers) worker->Post(*w.ops);
+        for (auto& worker : workers)
+            while (worker->Stats().ops < w.ops->size()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double wallMs = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count() / 1000.0;
+        for (auto& worker : workers) {
+            EngineStats st = worker->Stats();
+            std::printf("  %-10s size=%zu height=%d cmp/op=%.1f %s=%llu  %.0f ns/op\n", EngineKindName(worker->kind),
+                st.size, st.height, (double)st.comparisons / (double)st.ops, EngineRestructureName(worker->kind),
+                (unsigned long long)st.rotations, st.nsPerOp);
+        }
+        std::printf("  wall %.1f ms for all engines\n", wallMs);
+    }
+}
+
+// Insert n random keys, look up n random keys (about half present), then erase
+// them all, timing each phase on the calling thread.
+template <typename Engine>
+void TimeEngine(const char* name, Engine& engine, const std::vector<Key>& keys, const std::vector<Key>& probes) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (Key k : keys) engine.Insert(k);
+    double insertNs = NsPerOp(t0, keys.size());
+    uint64_t cmp0 = engine.comparisons;
+    size_t hits = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (Key k : probes) hits += engine.Contains(k);
+    double searchNs = NsPerOp(t0, probes.size());
+    double searchCmp = (double)(engine.comparisons - cmp0) / (double)probes.size();
+    t0 = std::chrono::steady_clock::now();
+    for (Key k : keys) engine.Erase(k);
+    double eraseNs = NsPerOp(t0, keys.size());
+    std::printf("  %-10s insert %6.1f  search %6.1f (%.1f cmp, %zu hits)  erase %6.1f  ns/op\n", name, insertNs, searchNs, searchCmp, hits, eraseNs);
+}
+
+// Skip list head to head with the balanced engines on one thread, so the
+// numbers are not skewed by the workers sharing cores.
+void RunSkipListBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Key> keys(n), probes(n);
+    for (Key& k : keys) k = (Key)(rng() % (2 * n));
+    for (Key& k : probes) k = (Key)(rng() % (2 * n));
+    std::printf("skiplist n=%zu\n", n);
+    OrderedEngine avl(ENGINE_AVL), redBlack(ENGINE_RED_BLACK);
+    BPlusTree pages;
+    SkipList skip((unsigned)seed);
+    TimeEngine(EngineKindName(ENGINE_AVL), avl, keys, probes);
+    TimeEngine(EngineKindName(ENGINE_RED_BLACK), redBlack, keys, probes);
+    TimeEngine(EngineKindName(ENGINE_BPLUS), pages, keys, probes);
+    TimeEngine(EngineKindName(ENGINE_SKIP_LIST), skip, keys, probes);
+}
+
+// Union / intersection / difference of an n-key and an m-key treap for m from n
+// down to n/1000: join-based (one thread, then the shared pool) vs merging the
+// in-order streams. Operands are fresh copies each time and copying is untimed.
+void RunSetOpsBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    TaskPool& pool = SharedTaskPool();
+    std::printf("setops n=%zu, pool of %u threads\n", n, pool.Concurrency());
+    std::vector<Key> keys;
+    std::vector<Node*> nodes;
+    auto build = [&](size_t count) {
+        SampleSortedKeys(count, rng, keys);
+        nodes.clear();
+        for (Key k : keys) nodes.push_back(NewNode(k));
+        return LinkTreap(nodes);
+    };
+    Node* a = build(n);
+    for (size_t m : { n, n / 10, n / 100, n / 1000 }) {
+        if (m == 0) continue;
+        Node* b = build(m);
+        for (SetOp op : { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE }) {
+            double ms[3], freeMs = 0;
+            size_t resultSize = 0;
+            std::vector<Node*> dropped;
+            for (int mode = 0; mode < 3; ++mode) {
+                Node* x = CopyAsTreap(a);
+                Node* y = CopyAsTreap(b);
+                dropped.clear();
+                auto t0 = std::chrono::steady_clock::now();
+                Node* result = mode == 2 ? SetOperationByMerge(op, x, y, dropped) : SetOperation(op, x, y, mode ? &pool : nullptr, dropped);
+                ms[mode] = NsPerOp(t0, 1) / 1e6;
+                t0 = std::chrono::steady_clock::now();
+                for (Node* d : dropped) FreeTree(d);
+                if (mode == 0) freeMs = NsPerOp(t0, 1) / 1e6;
+                resultSize = g_arena.live;
+                FreeTree(result);
+                resultSize -= g_arena.live;
+            }
+            std::printf("  m=%-8zu %-12s join %8.2f ms  join x%u %8.2f ms  merge %8.2f ms  speedup %6.1fx  (%zu keys; freeing the rest %.1f ms)\n",
+                m, SetOpName(op), ms[0], pool.Concurrency(), ms[1], ms[2], ms[2] / ms[1], resultSize, freeMs);
+        }
+        FreeTree(b);
+    }
+    FreeTree(a);
+}
+
+// A treap of n keys against a copy with d keys toggled (added or removed):
+// digesting both, the hash-skipping diff, and a merge of the in-order streams.
+void RunDiffBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::printf("diff n=%zu\n", n);
+    std::vector<Key> keys, changedKeys;
+    std::vector<Node*> nodes;
+    auto build = [&](const std::vector<Key>& sorted) {
+        nodes.clear();
+        for (Key k : sorted) nodes.push_back(NewNode(k));
+        return LinkTreap(nodes);
+    };
+    SampleSortedKeys(n, rng, keys);
+    Node* a = build(keys);
+    DigestIndex da, db;
+    auto t0 = std::chrono::steady_clock::now();
+    DigestTree(a, da);
+    std::printf("  digest %8.2f ms\n", NsPerOp(t0, 1) / 1e6);
+    for (size_t d : { (size_t)0, (size_t)1, (size_t)10, (size_t)1000, n / 10 }) {
+        if (d > n) continue;
+        std::vector<bool> present(4 * n, false);
+        for (Key k : keys) present[(size_t)k] = true;
+        for (size_t i = 0; i < d; ++i) {
+            size_t k = rng() % (4 * n);
+            present[k] = !present[k];
+        }
+        changedKeys.clear();
+        for (size_t k = 0; k < present.size(); ++k) if (present[k]) changedKeys.push_back((Key)k);
+        Node* b = build(changedKeys);
+        DigestTree(b, db);
+
+        TreeDiff diff;
+        t0 = std::chrono::steady_clock::now();
+        DiffTreaps(a, &da, b, &db, diff);
+        double diffMs = NsPerOp(t0, 1) / 1e6;
+#if BST_MERKLE
+        TreeDiff merkleDiff;
+        t0 = std::chrono::steady_clock::now();
+        DiffTreaps(a, nullptr, b, nullptr, merkleDiff);
+        std::printf("  d=%-8zu diff on node hashes %9.3f ms (+%zu -%zu)\n", d, NsPerOp(t0, 1) / 1e6, merkleDiff.added.size(), merkleDiff.removed.size());
+#endif
+
+        t0 = std::chrono::steady_clock::now();
+        std::vector<Node*> xs, ys;
+        CollectInorder(a, xs);
+        CollectInorder(b, ys);
+        size_t added = 0, removed = 0, i = 0, j = 0;
+        while (i < xs.size() || j < ys.size()) {
+            if (j == ys.size() || (i < xs.size() && xs[i]->value < ys[j]->value)) { removed++; i++; }
+            else if (i == xs.size() || ys[j]->value < xs[i]->value) { added++; j++; }
+            else { i++; j++; }
+        }
+        double mergeMs = NsPerOp(t0, 1) / 1e6;
+        std::printf("  d=%-8zu diff %9.3f ms (+%zu -%zu, %zu compared, %zu subtrees / %zu keys skipped)  merge %8.2f ms (+%zu -%zu)\n",
+            d, diffMs, diff.added.size(), diff.removed.size(), diff.visited, diff.identicalSubtrees, diff.identicalNodes, mergeMs, added, removed);
+        FreeTree(b);
+    }
+    FreeTree(a);
+}
+
+// Two trees built from the same insert sequence: update cost with the hashes
+// kept, and whole-tree equality by root hash vs a paired in-order walk, before
+// and after one delete. Run it with and without BST_MERKLE to price the upkeep.
+void RunMerkleBench(size_t n, uint64_t seed) {
+    std::printf("merkle n=%zu node=%zuB merkle=%d\n", n, sizeof(Node), BST_MERKLE);
+    std::mt19937_64 rng(seed);
+    std::vector<Key> keys(n);
+    for (Key& k : keys) k = (Key)(rng() >> 24);
+    PathBuffer path;
+    Node* a = nullptr;
+    Node* b = nullptr;
+    auto t0 = std::chrono::steady_clock::now();
+    for (Key k : keys) InsertKey(a, k, path);
+    std::printf("  insert %6.1f ns/op\n", NsPerOp(t0, n));
+    for (Key k : keys) InsertKey(b, k, path);
+#if BST_MERKLE
+    t0 = std::chrono::steady_clock::now();
+    RefreshTree(a);
+    std::printf("  rehash whole tree %8.2f ms\n", NsPerOp(t0, 1) / 1e6);
+#endif
+    auto walkEqual = [](Node* x, Node* y) {
+        std::vector<std::pair<Node*, Node*>> stack{ { x, y } };
+        while (!stack.empty()) {
+            auto [p, q] = stack.back();
+            stack.pop_back();
+            if (!p || !q) {
+                if (p != q) return false;
+                continue;
+            }
+            if (p->value != q->value || IsTombstone(p) != IsTombstone(q)) return false;
+            stack.push_back({ p->left, q->left });
+            stack.push_back({ p->right, q->right });
+        }
+        return true;
+    };
+    for (int edited = 0; edited < 2; ++edited) {
+        if (edited) {
+            t0 = std::chrono::steady_clock::now();
+            DeleteKey(b, keys[rng() % n], path);
+            std::printf("  delete one key %8.0f ns\n", NsPerOp(t0, 1));
+        }
+        t0 = std::chrono::steady_clock::now();
+        bool byHash = SameTree(a, b);
+        double hashNs = NsPerOp(t0, 1);
+        t0 = std::chrono::steady_clock::now();
+        bool byWalk = walkEqual(a, b);
+        std::printf("  %s equal: root hash %s in %.0f ns   walk %s in %.2f ms\n", edited ? "after delete," : "identical,",
+            BST_MERKLE ? (byHash ? "yes" : "no") : "n/a", hashNs, byWalk ? "yes" : "no", NsPerOp(t0, 1) / 1e6);
+    }
+    t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) DeleteKey(b, keys[i], path);
+    std::printf("  delete %6.1f ns/op\n", NsPerOp(t0, n));
+    FreeTree(a);
+    FreeTree(b);
+}
+
+// 32-bit keys, dense (a permutation of 0..n-1) and sparse (uniform random):
+// radix tree vs the arena BST, each built, probed and freed in turn so only one
+// is resident at a time.
+void RunRadixBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Key> keys(n), probes(n);
+    for (int sparse = 0; sparse < 2; ++sparse) {
+        for (size_t i = 0; i < n; ++i) keys[i] = sparse ? (Key)(uint32_t)rng() : (Key)i;
+        if (!sparse) std::shuffle(keys.begin(), keys.end(), rng);
+        for (size_t i = 0; i < n; ++i) probes[i] = (i & 1) ? keys[rng() % n] : (sparse ? (Key)(uint32_t)rng() : (Key)(rng() % (2 * n)));
+        std::printf("radix n=%zu %s 32-bit keys\n", n, sparse ? "sparse" : "dense");
+
+        size_t hits = 0;
+        {
+            RadixTree radix;
+            auto t0 = std::chrono::steady_clock::now();
+            for (Key k : keys) radix.Insert(k);
+            double insertNs = NsPerOp(t0, n);
+            uint64_t cmp0 = radix.comparisons;
+            t0 = std::chrono::steady_clock::now();
+            for (Key k : probes) hits += radix.Contains(k);
+            double searchNs = NsPerOp(t0, n);
+            std::printf("  radix  insert %6.1f  search %6.1f ns/op  %.1f byte steps/search  height=%d  %.1f B/key  (%zu hits)\n",
+                insertNs, searchNs, (double)(radix.comparisons - cmp0) / (double)n, radix.Height(),
+                (double)radix.bytes / (double)radix.size, hits);
+        }
+        hits = 0;
+        Node* tree = nullptr;
+        PathBuffer path;
+        auto t0 = std::chrono::steady_clock::now();
+        for (Key k : keys) InsertKey(tree, k, path);
+        double insertNs = NsPerOp(t0, n);
+        t0 = std::chrono::steady_clock::now();
+        for (Key k : probes) hits += FindWithParent(tree, k).second != nullptr;
+        double searchNs = NsPerOp(t0, n);
+        ShapeStats st = MeasureShape(tree);
+        std::printf("  bst    insert %6.1f  search %6.1f ns/op  avg depth %.1f          height=%d  %zu B/node (%zu hits)\n",
+            insertNs, searchNs, st.avgDepth, st.height, sizeof(Node), hits);
+        FreeTree(tree);
+    }
+}
+
+// Bounded in-order walk of the binary tree: descend to lo, then pop nodes in
+// order until one exceeds hi.
+template <typename Visit>
+size_t InorderRange(Node* rootRef, Key lo, Key hi, std::vector<Node*>& stack, Visit&& visit) {
+    size_t count = 0;
+    stack.clear();
+    Node* cur = rootRef;
+    while (cur || !stack.empty()) {
+        while (cur) {
+            if (cur->value < lo) cur = cur->right;
+            else { stack.push_back(cur); cur = cur->left; }
+        }
+        if (stack.empty()) break;
+        cur = stack.back();
+        stack.pop_back();
+        if (cur->value > hi) break;
+        if (!IsTombstone(cur)) {
+            visit(cur->value);
+            count++;
+        }
+        cur = cur->right;
+    }
+    return count;
+}
+
+// Range scans of several widths: B+ tree leaf chain (two page sizes) and skip
+// list bottom lane vs an in-order walk of the binary tree holding the same keys.
+void RunScanBench(size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Key> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = (Key)i;
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::printf("scan n=%zu\n", n);
+
+    PathBuffer path;
+    Node* tree = nullptr;
+    for (Key k : keys) InsertKey(tree, k, path);
+    BPlusTree small(BPlusTree::DEFAULT_PAGE_KEYS), large(64);
+    SkipList skip;
+    for (Key k : keys) {
+        small.Insert(k);
+        large.Insert(k);
+        skip.Insert(k);
+    }
+    std::vector<Node*> stack;
+    for (size_t width : { (size_t)10, (size_t)1000, (size_t)100000, n }) {
+        width = std::min(width, n);
+        // about 2*n keys visited per width, at least 4 scans
+        size_t scans = std::max<size_t>(4, 2 * n / width);
+        std::vector<Key> starts(scans);
+        for (Key& lo : starts) lo = (Key)(rng() % (n - width + 1));
+        std::printf("  width %-8zu %6zu scans:", width, scans);
+        Key sink = 0;
+        size_t visited = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (Key lo : starts) visited += InorderRange(tree, lo, lo + (Key)width - 1, stack, [&](Key k) { sink += k; });
+        std::printf("  bst %6.2f", NsPerOp(t0, visited));
+        for (BPlusTree* pages : { &small, &large }) {
+            visited = 0;
+            t0 = std::chrono::steady_clock::now();
+            for (Key lo : starts) visited += pages->RangeScan(lo, lo + (Key)width - 1, [&](Key k) { sink += k; });
+            std::printf("  b+%d %6.2f", pages->maxKeys, NsPerOp(t0, visited));
+        }
+        visited = 0;
+        t0 = std::chrono::steady_clock::now();
+        for (Key lo : starts) visited += skip.RangeScan(lo, lo + (Key)width - 1, [&](Key k) { sink += k; });
+        std::printf("  skip %6.2f", NsPerOp(t0, visited));
+        std::printf("  ns/key (checksum %lld)\n", (long long)sink);
+    }
+    FreeTree(tree);
+}
+
+// Generated trees vs building the same kind of tree by n inserts.
+void RunGenerateBench(size_t n, uint64_t seed) {
+    std::printf("generate n=%zu\n", n);
+    Node* tree = nullptr;
+    for (GenShape shape : { GEN_RANDOM, GEN_BALANCED }) {
+        auto t0 = std::chrono::steady_clock::now();
+        GenerateTree(tree, n, seed, shape);
+        double ns = NsPerOp(t0, n);
+        ShapeStats st = MeasureShape(tree);
+        std::printf("  generate %-9s %6.1f ns/node  height=%d avg depth=%.1f\n", GenShapeName(shape), ns, st.height, st.avgDepth);
+    }
+    FreeTree(tree);
+    tree = nullptr;
+
+    // baseline: insert a random permutation of the same number of distinct keys
+    std::mt19937_64 rng(seed);
+    std::vector<Key> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = (Key)i * 4;
+    std::shuffle(keys.begin(), keys.end(), rng);
+    PathBuffer path;
+    auto t0 = std::chrono::steady_clock::now();
+    for (Key k : keys) InsertKey(tree, k, path);
+    double ns = NsPerOp(t0, n);
+    ShapeStats st = MeasureShape(tree);
+    std::printf("  insert permutation %6.1f ns/node  height=%d avg depth=%.1f\n", ns, st.height, st.avgDepth);
+    FreeTree(tree);
+}
+
+// Smallest n a bench can run with: some split n into rounds, sample keys from
+// it or report averages per key.
+size_t MinBenchSize(const std::string& cmd) {
+    if (cmd == "churn") return 4;
+    if (cmd == "scan") return 1;
+    if (cmd == "range") return 1;
+    if (cmd == "defrag") return 1;
+    if (cmd == "merkle") return 1;
+    if (cmd == "radix" || cmd == "skiplist" || cmd == "compare") return 1;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string cmd = argc > 1 ? argv[1] : "ops";
+    size_t n = argc > 2 ? (size_t)std::strtoull(argv[2], nullptr, 10) : 1000000;
+    uint64_t seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+    if (argc > 2 && n < MinBenchSize(cmd)) {
+        std::fprintf(stderr, "%s: n must be at least %zu\n", cmd.c_str(), MinBenchSize(cmd));
+        return 1;
+    }
+    if (cmd == "ops") RunOpsBench(n, seed);
+    else if (cmd == "hugepages") RunHugePagesBench(n, seed);
+    else if (cmd == "defrag") RunDefragBench(n, seed);
+    else if (cmd == "tombstone") RunTombstoneBench(n, seed);
+    else if (cmd == "range") RunRangeDeleteBench(n, seed);
+    else if (cmd == "churn") RunChurnBench(argc > 2 ? n : 1000, seed);
+    else if (cmd == "compare") RunCompareBench(n, seed);
+    else if (cmd == "generate") RunGenerateBench(n, seed);
+    else if (cmd == "scan") RunScanBench(n, seed);
+    else if (cmd == "skiplist") RunSkipListBench(n, seed);
+    else if (cmd == "radix") RunRadixBench(n, seed);
+    else if (cmd == "setops") RunSetOpsBench(n, seed);
+    else if (cmd == "diff") RunDiffBench(n, seed);
+    else if (cmd == "merkle") RunMerkleBench(n, seed);
+    else {
+        std::fprintf(stderr, "usage: %s [ops|hugepages|defrag|tombstone|range|churn|compare|generate|scan|skiplist|radix|setops|diff|merkle] [n] [seed]\n", argv[0]);
+        return 1;
+    }
     return 0;
 }
+
+#endif // BST_HEADLESS